@@ -0,0 +1,340 @@
+#include <array>
+#include <climits>
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include "BinaryBuffer.h"
+#include "../contest/test.h"
+
+namespace condense {
+
+TEST_BEGIN()
+
+/* no padding, so that two writers of it produce the same bytes */
+struct TestPod {
+    std::int16_t a;
+    char c[2];
+    float b;
+    double d;
+
+    friend bool operator==(TestPod const &, TestPod const &) = default;
+};
+static_assert(sizeof(TestPod) == 16);
+
+/* a byte first, so that everything after it sits at an odd offset */
+template <class Writer>
+static void write_sample(Writer &w) {
+    std::vector<std::uint16_t> shorts{1, 2, 0xffff};
+    std::array<std::int32_t, 3> ints{-1, 0, 1 << 30};
+    w.write(std::uint8_t(7));
+    w.require(sizeof(float) + sizeof(std::int64_t));
+    w.write_unchecked(1.5f);
+    w.write_unchecked(std::int64_t(-42));
+    w.write(std::uint64_t(0x0102030405060708));
+    w.write(TestPod{-3, {'x', 'y'}, 2.5f, -0.25});
+    w.write_span(shorts);
+    w.write_span(std::span<std::int32_t const, 3>(ints));
+}
+
+static constexpr std::size_t sample_size = 1 + 8 + sizeof(TestPod) + 3 * 2 + 3 * 4 + 4 + 8;
+
+static bool read_sample(BinaryReader &r) {
+    bool ok = r.read<std::uint8_t>() == 7;
+    r.require(sizeof(float) + sizeof(std::int64_t));
+    ok &= r.read_unchecked<float>() == 1.5f;
+    ok &= r.read_unchecked<std::int64_t>() == -42;
+    ok &= r.read<std::uint64_t>() == 0x0102030405060708;
+    ok &= r.read<TestPod>() == TestPod{-3, {'x', 'y'}, 2.5f, -0.25};
+    std::vector<std::uint16_t> shorts(3);
+    r.read_into(shorts);
+    ok &= shorts == std::vector<std::uint16_t>{1, 2, 0xffff};
+    std::array<std::int32_t, 3> ints;
+    r.read_into(std::span<std::int32_t, 3>(ints));
+    ok &= ints == std::array<std::int32_t, 3>{-1, 0, 1 << 30};
+    return ok && r.remaining() == 0;
+}
+
+TEST(BinaryBufferRoundTrip) {
+    std::vector<std::byte> grown;
+    BinaryExtensiveWriter ew(grown);
+    write_sample(ew);
+    EXPECT_EQ(grown.size(), sample_size);
+
+    /* the fixed writer produces the same bytes */
+    std::vector<std::byte> fixed(sample_size);
+    BinaryWriter fw(fixed);
+    write_sample(fw);
+    EXPECT_EQ(fw.remaining(), 0);
+    EXPECT_EQ(fixed == grown, true);
+
+    BinaryReader r(grown);
+    EXPECT_EQ(read_sample(r), true);
+
+    /* and it reads back the same from an odd address */
+    std::vector<std::byte> shifted(sample_size + 1);
+    std::copy(grown.begin(), grown.end(), shifted.begin() + 1);
+    BinaryReader rs(std::span<std::byte const>(shifted).subspan(1));
+    EXPECT_EQ(read_sample(rs), true);
+}
+
+static bool throws_out_of_range(auto &&fn) {
+    try {
+        fn();
+    } catch (std::out_of_range const &) {
+        return true;
+    }
+    return false;
+}
+
+/* a short buffer throws before anything is consumed or written */
+TEST(BinaryBufferShortBuffer) {
+    std::byte bytes[6]{};
+    BinaryReader r(std::span<std::byte const>(bytes, 3));
+    EXPECT_EQ(throws_out_of_range([&] { r.read<std::uint32_t>(); }), true);
+    EXPECT_EQ(throws_out_of_range([&] { r.require(4); }), true);
+    std::vector<std::uint16_t> two(2);
+    EXPECT_EQ(throws_out_of_range([&] { r.read_into(two); }), true);
+    std::vector<std::uint16_t> scratch;
+    EXPECT_EQ(throws_out_of_range([&] { r.read_span<std::uint16_t>(2, scratch); }), true);
+    /* n * sizeof(T) would wrap around to 0 */
+    EXPECT_EQ(throws_out_of_range([&] { r.read_span<std::uint16_t>(std::size_t(-1) / 2 + 1, scratch); }), true);
+    EXPECT_EQ(r.remaining(), 3);
+    r.require(3);
+    EXPECT_EQ(r.read<std::uint16_t>(), 0);
+    EXPECT_EQ(throws_out_of_range([&] { r.read<std::uint16_t>(); }), true);
+    EXPECT_EQ(r.remaining(), 1);
+
+    BinaryWriter w(std::span<std::byte>(bytes, 6));
+    w.write(std::uint32_t(1));
+    EXPECT_EQ(throws_out_of_range([&] { w.write(std::uint32_t(2)); }), true);
+    std::array<std::uint16_t, 2> in{3, 4};
+    EXPECT_EQ(throws_out_of_range([&] { w.write_span(in); }), true);
+    EXPECT_EQ(throws_out_of_range([&] { w.require(3); }), true);
+    EXPECT_EQ(w.remaining(), 2);
+    w.write(std::uint16_t(5));
+    EXPECT_EQ(w.remaining(), 0);
+}
+
+/* read_span views the buffer where it is aligned for T and copies into scratch where
+ * it is not; the values are the same either way */
+TEST(BinaryBufferReadSpan) {
+    alignas(8) std::byte bytes[64];
+    for (int i = 0; i < 64; i++) {
+        bytes[i] = static_cast<std::byte>(i);
+    }
+    std::vector<std::uint32_t> scratch;
+    auto expect_at = [&] (std::size_t off, std::size_t k) {
+        std::uint32_t x;
+        std::memcpy(&x, bytes + off + 4 * k, 4);
+        return x;
+    };
+
+    BinaryReader r(bytes);
+    auto view = r.read_span<std::uint32_t>(4, scratch);
+    EXPECT_EQ((void const *)view.data() == bytes, true);
+    EXPECT_EQ(scratch.empty(), true);
+    EXPECT_EQ(view[3], expect_at(0, 3));
+
+    r.read<std::uint8_t>(); /* now at offset 17 */
+    auto copy = r.read_span<std::uint32_t>(5, scratch);
+    EXPECT_EQ(copy.data() == scratch.data(), true);
+    EXPECT_EQ(copy.size(), 5);
+    bool same = true;
+    for (std::size_t k = 0; k < 5; k++) {
+        same &= copy[k] == expect_at(17, k);
+    }
+    EXPECT_EQ(same, true);
+    EXPECT_EQ(r.remaining(), 64 - 17 - 20);
+
+    auto none = r.read_span<std::uint32_t>(0, scratch);
+    EXPECT_EQ(none.size(), 0);
+    EXPECT_EQ(r.remaining(), 64 - 17 - 20);
+}
+
+TEST(BinaryBufferVarint) {
+    std::uint64_t const values[] = {0, 127, 128, std::uint64_t(1) << 63,
+        std::uint64_t(INT64_MAX), UINT64_MAX};
+    std::size_t const lengths[] = {1, 1, 2, 10, 9, 10};
+    std::vector<std::byte> grown;
+    BinaryExtensiveWriter ew(grown);
+    bool ok = true;
+    for (int i = 0; i < 6; i++) {
+        std::byte tmp[10];
+        ok &= encode_varint(tmp, values[i]) == lengths[i];
+        ew.write_varint(values[i]);
+    }
+    EXPECT_EQ(ok, true);
+    std::byte tmp[10];
+    encode_varint(tmp, 128);
+    EXPECT_EQ((tmp[0] == std::byte(0x80) && tmp[1] == std::byte(0x01)), true);
+
+    std::int64_t const signed_values[] = {0, 127, 128, -128, INT64_MIN, INT64_MAX};
+    for (std::int64_t x: signed_values) {
+        ok &= zigzag_decode(zigzag_encode(x)) == x;
+        ew.write_zigzag(x);
+    }
+    EXPECT_EQ(ok, true);
+    EXPECT_EQ(zigzag_encode(-1), 1);
+    EXPECT_EQ(zigzag_encode(INT64_MIN), UINT64_MAX);
+
+    /* the fixed writer produces the same bytes */
+    std::vector<std::byte> fixed(grown.size());
+    BinaryWriter fw(fixed);
+    for (std::uint64_t x: values) {
+        fw.write_varint(x);
+    }
+    for (std::int64_t x: signed_values) {
+        fw.write_zigzag(x);
+    }
+    EXPECT_EQ(fw.remaining(), 0);
+    EXPECT_EQ(fixed == grown, true);
+
+    BinaryReader r(grown);
+    for (std::uint64_t x: values) {
+        ok &= r.read_varint() == x;
+    }
+    for (std::int64_t x: signed_values) {
+        ok &= r.read_zigzag() == x;
+    }
+    EXPECT_EQ(ok, true);
+    EXPECT_EQ(r.remaining(), 0);
+}
+
+/* a 10th byte carrying anything beyond bit 63, or a continuation, is rejected */
+TEST(BinaryBufferVarintOverlong) {
+    auto read_with_last = [] (std::uint8_t last) {
+        std::byte bytes[10];
+        std::fill_n(bytes, 9, std::byte(0x80));
+        bytes[9] = std::byte(last);
+        BinaryReader r(bytes);
+        return r.read_varint();
+    };
+    EXPECT_EQ(read_with_last(0x01), std::uint64_t(1) << 63);
+    EXPECT_EQ(read_with_last(0x00), 0);
+    EXPECT_EQ(throws_out_of_range([&] { read_with_last(0x02); }), true);
+    EXPECT_EQ(throws_out_of_range([&] { read_with_last(0x7f); }), true);
+    EXPECT_EQ(throws_out_of_range([&] { read_with_last(0x81); }), true);
+
+    /* and so is one cut short */
+    std::byte cut[3]{std::byte(0x80), std::byte(0x80), std::byte(0x80)};
+    BinaryReader r(cut);
+    EXPECT_EQ(throws_out_of_range([&] { r.read_varint(); }), true);
+}
+
+static std::vector<std::uint32_t> varint_array_sample() {
+    std::vector<std::uint32_t> v;
+    for (std::uint32_t i = 0; i < 100; i++) {
+        v.push_back(i * i * i * 4099);
+    }
+    v.push_back(0);
+    v.push_back(UINT32_MAX);
+    return v;
+}
+
+/* the same bytes from the extensive writer, the fixed writer encoding in place (room for the
+ * worst case) and the fixed writer going through a copy (room only for what it writes) */
+TEST(BinaryBufferVarintArray) {
+    auto const in = varint_array_sample();
+    std::vector<std::byte> grown(3, std::byte(0xee));
+    BinaryExtensiveWriter ew(grown);
+    ew.write(std::uint8_t(1));
+    ew.write_varint_array(in);
+    ew.write_varint_array(std::span<std::uint32_t const>());
+    EXPECT_LT(grown.size(), 1 + consimd::streamvbyte_max_length(in.size()) + 2);
+
+    std::vector<std::byte> roomy(grown.size() + consimd::streamvbyte_max_length(in.size()), std::byte(0xee));
+    BinaryWriter fw(roomy);
+    fw.write(std::uint8_t(1));
+    fw.write_varint_array(in);
+    fw.write_varint_array(std::span<std::uint32_t const>());
+    EXPECT_EQ(std::equal(grown.begin(), grown.end(), roomy.begin()), true);
+
+    std::vector<std::byte> exact(grown.size());
+    BinaryWriter xw(exact);
+    xw.write(std::uint8_t(1));
+    xw.write_varint_array(in);
+    xw.write_varint_array(std::span<std::uint32_t const>());
+    EXPECT_EQ(xw.remaining(), 0);
+    EXPECT_EQ(exact == grown, true);
+
+    BinaryReader r(exact);
+    EXPECT_EQ(r.read<std::uint8_t>(), 1);
+    std::vector<std::uint32_t> out{5};
+    r.read_varint_array(out);
+    EXPECT_EQ(out == in, true);
+    r.read_varint_array(out);
+    EXPECT_EQ(out.empty(), true);
+    EXPECT_EQ(r.remaining(), 0);
+
+    /* one byte short of the data throws, and so does a writer short of it */
+    BinaryReader rs(std::span<std::byte const>(exact).first(exact.size() - 2));
+    rs.read<std::uint8_t>();
+    EXPECT_EQ(throws_out_of_range([&] { rs.read_varint_array(out); }), true);
+    std::vector<std::byte> small(exact.size() - 2);
+    BinaryWriter sw(small);
+    sw.write(std::uint8_t(1));
+    EXPECT_EQ(throws_out_of_range([&] { sw.write_varint_array(in); }), true);
+}
+
+/* a sorted run, then jumps between the ends of int whose differences only fit modulo 2^32 */
+static std::vector<int> delta_column_sample() {
+    std::vector<int> v;
+    for (int i = 0; i < 300; i++) {
+        v.push_back(1000 + i * 3);
+    }
+    for (int i = 0; i < 100; i++) {
+        v.push_back(i % 2 ? INT_MAX : INT_MIN);
+    }
+    v.push_back(0);
+    v.push_back(-1);
+    return v;
+}
+
+TEST_TYPES(BinaryBufferStrategies
+           , consimd::strategy::AVX
+           , consimd::strategy::Scalar
+           );
+
+TEST_T(BinaryBufferDeltaColumn, BinaryBufferStrategies) {
+    auto const in = delta_column_sample();
+    std::vector<std::byte> grown;
+    BinaryExtensiveWriter ew(grown);
+    ew.write(std::uint8_t(1));
+    ew.write_delta_column(in, TestType{});
+    ew.write_delta_column(std::span<int const>(), TestType{});
+    ew.write(std::uint8_t(2));
+
+    BinaryReader r(grown);
+    EXPECT_EQ(r.read<std::uint8_t>(), 1);
+    std::vector<int> out{5};
+    r.read_delta_column(out, TestType{});
+    EXPECT_EQ(out == in, true);
+    r.read_delta_column(out, TestType{});
+    EXPECT_EQ(out.empty(), true);
+    EXPECT_EQ(r.read<std::uint8_t>(), 2);
+    EXPECT_EQ(r.remaining(), 0);
+
+    /* every cut short of the column throws, be it inside a header or inside a block */
+    bool ok = true;
+    for (std::size_t len: {std::size_t(1), std::size_t(2), std::size_t(5), std::size_t(300), grown.size() - 3}) {
+        BinaryReader rs(std::span<std::byte const>(grown).first(len));
+        rs.read<std::uint8_t>();
+        ok &= throws_out_of_range([&] { rs.read_delta_column(out, TestType{}); });
+    }
+    EXPECT_EQ(ok, true);
+
+    /* a block header claiming more than 32 bits throws before anything is decoded */
+    std::vector<std::byte> corrupt = grown;
+    std::size_t first_block = 1 + 2; /* the tag byte, then 402 as a varint */
+    corrupt[first_block + 4] = std::byte(33);
+    BinaryReader rc(corrupt);
+    rc.read<std::uint8_t>();
+    EXPECT_EQ(throws_out_of_range([&] { rc.read_delta_column(out, TestType{}); }), true);
+    EXPECT_EQ(rc.remaining(), corrupt.size() - 1 - 2);
+}
+
+TEST_END()
+
+}
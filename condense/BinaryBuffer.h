@@ -1,10 +1,45 @@
+#pragma once
+
 #include <span>
+#include <ranges>
 #include <memory>
 #include <vector>
 #include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <algorithm>
+#include "../consimd/streamvbyte.h"
+#include "../consimd/delta_bitpack.h"
+#include "../consimd/strategy.h"
 
 namespace condense {
 
+/* maps signed to unsigned so that small magnitudes of either sign give short varints:
+ * 0, -1, 1, -2, 2, ... -> 0, 1, 2, 3, 4, ... */
+inline constexpr std::uint64_t zigzag_encode(std::int64_t x) noexcept {
+    return (static_cast<std::uint64_t>(x) << 1) ^ static_cast<std::uint64_t>(x >> 63);
+}
+
+inline constexpr std::int64_t zigzag_decode(std::uint64_t x) noexcept {
+    return static_cast<std::int64_t>(x >> 1) ^ -static_cast<std::int64_t>(x & 1);
+}
+
+/* LEB128: 7 bits per byte, low groups first, the high bit set on all but the last byte;
+ * returns the length, at most 10 */
+inline size_t encode_varint(std::byte *out, std::uint64_t x) noexcept {
+    size_t n = 0;
+    while (x >= 0x80) {
+        out[n++] = static_cast<std::byte>(x | 0x80);
+        x >>= 7;
+    }
+    out[n++] = static_cast<std::byte>(x);
+    return n;
+}
+
+/* the bulk and unchecked members move trivially copyable T as raw bytes; the unchecked
+ * ones are meant for a loop after a single require() covering all of it */
 struct BinaryReader {
 private:
     std::span<std::byte const> buf;
@@ -23,6 +58,110 @@ public:
         offset += sizeof(T);
         return std::move(*reinterpret_cast<T *>(tmp));
     }
+
+    constexpr size_t remaining() const noexcept {
+        return buf.size() - offset;
+    }
+
+    constexpr void require(size_t nbytes) const {
+        if (nbytes > remaining())
+            throw std::out_of_range("BinaryReader::require");
+    }
+
+    template <class T>
+    T read_unchecked() noexcept {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T t;
+        std::memcpy(&t, buf.data() + offset, sizeof(T));
+        offset += sizeof(T);
+        return t;
+    }
+
+    /* fills out with one bounds check and one memcpy */
+    template <class T, size_t Extent>
+    void read_into(std::span<T, Extent> out) {
+        static_assert(std::is_trivially_copyable_v<T> && !std::is_const_v<T>);
+        require(out.size_bytes());
+        std::memcpy(out.data(), buf.data() + offset, out.size_bytes());
+        offset += out.size_bytes();
+    }
+
+    /* read_into over a vector, array or other contiguous range */
+    template <std::ranges::contiguous_range R> requires std::ranges::sized_range<R>
+    void read_into(R &&out) {
+        read_into(std::span(std::ranges::data(out), std::ranges::size(out)));
+    }
+
+    std::uint64_t read_varint() {
+        std::uint64_t x = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            if (offset == buf.size())
+                throw std::out_of_range("BinaryReader::read_varint");
+            auto b = std::to_integer<std::uint64_t>(buf[offset++]);
+            if (shift == 63 && (b & 0x7e)) /* the 10th byte only has room for bit 63 */
+                throw std::out_of_range("BinaryReader::read_varint");
+            x |= (b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return x;
+        }
+        throw std::out_of_range("BinaryReader::read_varint");
+    }
+
+    std::int64_t read_zigzag() {
+        return zigzag_decode(read_varint());
+    }
+
+    /* an array written by write_varint_array: its length as a varint, then Stream VByte */
+    template <class Strategy = consimd::strategy::Scalar>
+    void read_varint_array(std::vector<std::uint32_t> &out, Strategy = {}) {
+        size_t n = read_varint();
+        if (n > remaining()) /* every value takes at least one byte */
+            throw std::out_of_range("BinaryReader::read_varint_array");
+        auto control = reinterpret_cast<std::uint8_t const *>(buf.data() + offset);
+        size_t ncontrol = consimd::streamvbyte_control_length(n);
+        require(ncontrol);
+        size_t len = ncontrol + consimd::streamvbyte_data_length(control, n);
+        require(len);
+        out.resize(n);
+        consimd::streamvbyte_decode<Strategy>()(control, out.data(), n);
+        offset += len;
+    }
+
+    /* a column written by write_delta_column; the block headers are checked against the
+     * buffer before any of it is decoded */
+    template <class Strategy = consimd::strategy::Scalar>
+    void read_delta_column(std::vector<int> &out, Strategy = {}) {
+        size_t n = read_varint();
+        auto in = reinterpret_cast<std::uint8_t const *>(buf.data() + offset);
+        size_t len = 0;
+        for (size_t i = 0; i < n; i += consimd::delta_bitpack_block_size) {
+            require(len + consimd::delta_bitpack_header_size);
+            if (in[len + 4] > 32)
+                throw std::out_of_range("BinaryReader::read_delta_column");
+            len += consimd::delta_bitpack_block_length(in + len);
+        }
+        require(len);
+        out.resize(n);
+        consimd::delta_bitpack_decode<Strategy>()(in, out.data(), n);
+        offset += len;
+    }
+
+    /* n values of T: a view straight into the buffer if it happens to be aligned for T,
+     * otherwise a copy in scratch; either way valid until the buffer or scratch changes */
+    template <class T>
+    std::span<T const> read_span(size_t n, std::vector<T> &scratch) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (n > remaining() / sizeof(T))
+            throw std::out_of_range("BinaryReader::read_span");
+        std::byte const *p = buf.data() + offset;
+        offset += n * sizeof(T);
+        if (reinterpret_cast<std::uintptr_t>(p) % alignof(T) == 0) {
+            return {reinterpret_cast<T const *>(p), n};
+        }
+        scratch.resize(n);
+        std::memcpy(scratch.data(), p, n * sizeof(T));
+        return {scratch.data(), n};
+    }
 };
 
 struct BinaryWriter {
@@ -41,6 +180,65 @@ public:
         std::memcpy(buf.data() + offset, tmp, sizeof(T));
         offset += sizeof(T);
     }
+
+    constexpr size_t remaining() const noexcept {
+        return buf.size() - offset;
+    }
+
+    constexpr void require(size_t nbytes) const {
+        if (nbytes > remaining())
+            throw std::out_of_range("BinaryWriter::require");
+    }
+
+    template <class T>
+    void write_unchecked(T const &t) noexcept {
+        static_assert(std::is_trivially_copyable_v<T>);
+        std::memcpy(buf.data() + offset, std::addressof(t), sizeof(T));
+        offset += sizeof(T);
+    }
+
+    template <class T, size_t Extent>
+    void write_span(std::span<T, Extent> in) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        require(in.size_bytes());
+        std::memcpy(buf.data() + offset, in.data(), in.size_bytes());
+        offset += in.size_bytes();
+    }
+
+    template <std::ranges::contiguous_range R> requires std::ranges::sized_range<R>
+    void write_span(R const &in) {
+        write_span(std::span(std::ranges::data(in), std::ranges::size(in)));
+    }
+
+    void write_varint(std::uint64_t x) {
+        std::byte tmp[10];
+        size_t n = encode_varint(tmp, x);
+        require(n);
+        std::memcpy(buf.data() + offset, tmp, n);
+        offset += n;
+    }
+
+    void write_zigzag(std::int64_t x) {
+        write_varint(zigzag_encode(x));
+    }
+
+    /* the length as a varint, then the values as Stream VByte (1 to 4 bytes each plus two
+     * bits of control); encodes in place when the worst case fits, else via a copy */
+    template <class Strategy = consimd::strategy::Scalar>
+    void write_varint_array(std::span<std::uint32_t const> in, Strategy = {}) {
+        write_varint(in.size());
+        size_t maxlen = consimd::streamvbyte_max_length(in.size());
+        if (maxlen <= remaining()) {
+            auto out = reinterpret_cast<std::uint8_t *>(buf.data() + offset);
+            offset += consimd::streamvbyte_encode<Strategy>()(in.data(), out, in.size());
+        } else {
+            std::vector<std::uint8_t> tmp(maxlen);
+            size_t len = consimd::streamvbyte_encode<Strategy>()(in.data(), tmp.data(), in.size());
+            require(len);
+            std::memcpy(buf.data() + offset, tmp.data(), len);
+            offset += len;
+        }
+    }
 };
 
 struct BinaryExtensiveWriter {
@@ -59,6 +257,69 @@ public:
         std::memcpy(buf.data() + offset, tmp, sizeof(T));
         offset += sizeof(T);
     }
+
+    /* grows the buffer to hold nbytes more, so that write_unchecked can follow */
+    void require(size_t nbytes) {
+        if (offset + nbytes > buf.size())
+            buf.resize(offset + nbytes);
+    }
+
+    template <class T>
+    void write_unchecked(T const &t) noexcept {
+        static_assert(std::is_trivially_copyable_v<T>);
+        std::memcpy(buf.data() + offset, std::addressof(t), sizeof(T));
+        offset += sizeof(T);
+    }
+
+    template <class T, size_t Extent>
+    void write_span(std::span<T, Extent> in) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        require(in.size_bytes());
+        std::memcpy(buf.data() + offset, in.data(), in.size_bytes());
+        offset += in.size_bytes();
+    }
+
+    template <std::ranges::contiguous_range R> requires std::ranges::sized_range<R>
+    void write_span(R const &in) {
+        write_span(std::span(std::ranges::data(in), std::ranges::size(in)));
+    }
+
+    void write_varint(std::uint64_t x) {
+        std::byte tmp[10];
+        size_t n = encode_varint(tmp, x);
+        require(n);
+        std::memcpy(buf.data() + offset, tmp, n);
+        offset += n;
+    }
+
+    void write_zigzag(std::int64_t x) {
+        write_varint(zigzag_encode(x));
+    }
+
+    /* same format as BinaryWriter::write_varint_array; the buffer grows by the worst case
+     * and is cut back to what was written */
+    template <class Strategy = consimd::strategy::Scalar>
+    void write_varint_array(std::span<std::uint32_t const> in, Strategy = {}) {
+        write_varint(in.size());
+        size_t size = buf.size();
+        require(consimd::streamvbyte_max_length(in.size()));
+        auto out = reinterpret_cast<std::uint8_t *>(buf.data() + offset);
+        offset += consimd::streamvbyte_encode<Strategy>()(in.data(), out, in.size());
+        buf.resize(std::max(size, offset));
+    }
+
+    /* the length as a varint, then the values delta + bit-packed in blocks of 256
+     * (consimd/delta_bitpack.h), for sorted ids, timestamps and other slowly varying
+     * columns */
+    template <class Strategy = consimd::strategy::Scalar>
+    void write_delta_column(std::span<int const> in, Strategy = {}) {
+        write_varint(in.size());
+        size_t size = buf.size();
+        require(consimd::delta_bitpack_max_length(in.size()));
+        auto out = reinterpret_cast<std::uint8_t *>(buf.data() + offset);
+        offset += consimd::delta_bitpack_encode<Strategy>()(in.data(), out, in.size());
+        buf.resize(std::max(size, offset));
+    }
 };
 
 }
@@ -0,0 +1,138 @@
+#include <new>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include "ConcurrentSparseVec.h"
+#include "../constl/resource_allocator.h"
+#include "../contest/test.h"
+
+namespace condense {
+
+TEST_BEGIN()
+
+/* operator new behind a counter, safe to share between producers */
+struct AtomicCountingResource {
+    std::atomic<std::size_t> m_live{0};
+    std::atomic<std::size_t> m_nallocs{0};
+
+    void *allocate(std::size_t bytes, std::size_t align) {
+        m_live += bytes;
+        m_nallocs++;
+        return ::operator new(bytes, std::align_val_t(align));
+    }
+
+    void deallocate(void *p, std::size_t bytes, std::size_t align) noexcept {
+        m_live -= bytes;
+        ::operator delete(p, std::align_val_t(align));
+    }
+};
+
+/* an element whose fields are written one after the other, so a reader that gets ahead
+ * of the constructor sees check != mix(value) */
+struct Item {
+    std::uint64_t value;
+    std::vector<std::uint64_t> payload;
+    std::uint64_t check;
+
+    static std::uint64_t mix(std::uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdull;
+        x ^= x >> 29;
+        return x;
+    }
+
+    explicit Item(std::uint64_t v) : value(v), payload(v % 7 + 1, v), check(mix(v)) {}
+
+    bool intact() const {
+        bool ok = check == mix(value) && payload.size() == value % 7 + 1;
+        for (std::uint64_t x: payload) {
+            ok &= x == value;
+        }
+        return ok;
+    }
+};
+
+/* producers push_back while a reader keeps walking the committed prefix: it only ever
+ * sees ids [0, size()) in order, every one fully constructed, and the prefix never shrinks */
+TEST(ConcurrentSparseVecPushWhileReading) {
+    constexpr std::size_t nthreads = 4, per_thread = 30000;
+    AtomicCountingResource res;
+    {
+        using Vec = ConcurrentSparseVec<Item, std::uint32_t, constl::resource_allocator<Item, AtomicCountingResource>, 6>;
+        Vec v{constl::resource_allocator<Item, AtomicCountingResource>(res)};
+        std::atomic<std::size_t> nproducing{nthreads};
+        std::atomic<bool> reader_ok{true};
+        std::size_t nseen = 0, npasses = 0;
+        {
+            std::vector<std::jthread> threads;
+            threads.emplace_back([&] {
+                bool ok = true;
+                std::size_t cursor = 0;
+                do {
+                    std::size_t expect_id = 0, last = v.size();
+                    v.foreach([&] (std::uint32_t id, Item const &item) {
+                        ok &= id == expect_id++ && item.intact();
+                    });
+                    ok &= expect_id >= last && v.size() >= expect_id;
+                    cursor = v.foreach_since(cursor, [&] (std::uint32_t id, Item const &item) {
+                        ok &= id == nseen++ && item.intact();
+                    });
+                    npasses++;
+                } while (nproducing.load() != 0);
+                cursor = v.foreach_since(cursor, [&] (std::uint32_t id, Item const &item) {
+                    ok &= id == nseen++ && item.intact();
+                });
+                reader_ok.store(ok);
+            });
+            for (std::size_t t = 0; t < nthreads; t++) {
+                threads.emplace_back([&, t] {
+                    for (std::size_t i = 0; i < per_thread; i++) {
+                        v.push_back(Item(t * per_thread + i));
+                    }
+                    nproducing--;
+                });
+            }
+        }
+        EXPECT_EQ(reader_ok.load(), true);
+        EXPECT_GT(npasses, 0);
+        EXPECT_EQ(nseen, nthreads * per_thread);
+        EXPECT_EQ(v.size(), nthreads * per_thread);
+
+        /* every value pushed came out exactly once */
+        std::vector<int> seen(nthreads * per_thread);
+        bool once = true;
+        v.foreach([&] (std::uint32_t, Item const &item) {
+            once &= item.value < seen.size() && seen[item.value]++ == 0;
+        });
+        EXPECT_EQ(once, true);
+        EXPECT_GT(res.m_nallocs.load(), 0);
+        EXPECT_EQ(&v.get_allocator().resource() == &res, true);
+    }
+    EXPECT_EQ(res.m_live.load(), 0);
+}
+
+TEST(ConcurrentSparseVecClearReuse) {
+    AtomicCountingResource res;
+    {
+        ConcurrentSparseVec<int, std::uint32_t, constl::resource_allocator<int, AtomicCountingResource>, 4>
+            v{constl::resource_allocator<int, AtomicCountingResource>(res)};
+        v.reserve(1000);
+        const std::size_t nallocs = res.m_nallocs.load();
+        for (int i = 0; i < 1000; i++) {
+            EXPECT_EQ(v.push_back(i), (std::uint32_t)i);
+        }
+        EXPECT_EQ(res.m_nallocs.load(), nallocs); /* reserve allocated every segment */
+        EXPECT_EQ(*v.at(999), 999);
+        EXPECT_EQ(v.at(1000) == nullptr, true);
+        v.clear();
+        EXPECT_EQ(v.size(), 0);
+        EXPECT_EQ(v.push_back(7), 0);
+        EXPECT_EQ(res.m_nallocs.load(), nallocs); /* the segments are kept */
+    }
+    EXPECT_EQ(res.m_live.load(), 0);
+}
+
+TEST_END()
+
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+#include <bit>
+#include "SparseVec.h"
+
+namespace condense {
+
+/* append-only SparseVec for many producers: push_back reserves a dense slot with one
+ * fetch_add and the id of an element is its slot. blocks of 1 << DenseBits live in
+ * segments of doubling size (segment s holds 1 << s blocks) that are allocated on first
+ * touch and never moved, so a reserved slot stays put while others grow the container.
+ * every slot has a ready flag; writers advance a committed counter over the ready
+ * prefix, and readers only look below it, so they see a consistent prefix while appends
+ * continue. clear is the only operation that must not race with the others. segments
+ * come from Alloc rebound to DenseBlock, which producers may call concurrently */
+template <class T, class Id = std::size_t, class Alloc = std::allocator<T>, std::size_t DenseBits = 8>
+struct ConcurrentSparseVec {
+    using id_type = Id;
+    using value_type = T;
+    using allocator_type = Alloc;
+
+    struct DenseBlock {
+        static const std::size_t N = DenseBits;
+        UninitArray<T, (1 << N)> vals;
+        std::atomic<bool> ready[1 << N];
+        DenseBlock() noexcept : ready{} {}
+    };
+
+    /* 1 + 2 + ... + 2^(MaxSegments - 1) blocks, enough for any Id */
+    static constexpr std::size_t MaxSegments = sizeof(Id) * 8 - DenseBits + 1;
+
+    using BlockAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<DenseBlock>;
+    using BlockTraits = std::allocator_traits<BlockAlloc>;
+
+    std::atomic<DenseBlock *> m_segments[MaxSegments];
+    [[no_unique_address]] BlockAlloc m_alloc;
+    alignas(64) std::atomic<std::size_t> m_reserved;  /* slots handed out */
+    alignas(64) std::atomic<std::size_t> m_committed; /* slots [0, m_committed) are ready */
+
+    ConcurrentSparseVec() noexcept : m_segments{}, m_reserved(0), m_committed(0) {}
+
+    explicit ConcurrentSparseVec(Alloc const &alloc) noexcept
+    : m_segments{}
+    , m_alloc(alloc)
+    , m_reserved(0)
+    , m_committed(0)
+    {}
+
+    ConcurrentSparseVec(ConcurrentSparseVec &&) = delete;
+    ConcurrentSparseVec &operator=(ConcurrentSparseVec &&) = delete;
+
+    ~ConcurrentSparseVec() noexcept {
+        clear();
+        for (std::size_t s = 0; s != MaxSegments; s++) {
+            if (DenseBlock *seg = m_segments[s].load(std::memory_order_relaxed)) {
+                _delete_segment(seg, s);
+            }
+        }
+    }
+
+    allocator_type get_allocator() const noexcept {
+        return allocator_type(m_alloc);
+    }
+
+    DenseBlock *_new_segment(std::size_t s) {
+        const std::size_t n = std::size_t(1) << s;
+        DenseBlock *seg = BlockTraits::allocate(m_alloc, n);
+        for (std::size_t i = 0; i != n; i++) {
+            BlockTraits::construct(m_alloc, seg + i);
+        }
+        return seg;
+    }
+
+    void _delete_segment(DenseBlock *seg, std::size_t s) noexcept {
+        const std::size_t n = std::size_t(1) << s;
+        for (std::size_t i = 0; i != n; i++) {
+            BlockTraits::destroy(m_alloc, seg + i);
+        }
+        BlockTraits::deallocate(m_alloc, seg, n);
+    }
+
+    static constexpr std::pair<std::size_t, std::size_t> _segment_of(std::size_t blknr) noexcept {
+        std::size_t s = std::bit_width(blknr + 1) - 1;
+        return {s, blknr + 1 - (std::size_t(1) << s)};
+    }
+
+    /* block blknr, allocating its segment if this is the first touch; racing allocators
+     * agree on the first pointer published and the others free theirs */
+    DenseBlock &_block_for_write(std::size_t blknr) {
+        auto [s, off] = _segment_of(blknr);
+        DenseBlock *seg = m_segments[s].load(std::memory_order_acquire);
+        if (!seg) [[unlikely]] {
+            DenseBlock *fresh = _new_segment(s);
+            if (m_segments[s].compare_exchange_strong(seg, fresh, std::memory_order_acq_rel)) {
+                seg = fresh;
+            } else {
+                _delete_segment(fresh, s);
+            }
+        }
+        return seg[off];
+    }
+
+    /* only valid for blocks holding a slot below m_reserved */
+    DenseBlock &_block(std::size_t blknr) const noexcept {
+        auto [s, off] = _segment_of(blknr);
+        return m_segments[s].load(std::memory_order_acquire)[off];
+    }
+
+    /* moves m_committed over every ready slot; whoever marks a slot ready afterwards sees
+     * either its own slot at the head or that a later caller has already passed it */
+    void _advance_committed() noexcept {
+        std::size_t c = m_committed.load();
+        while (c < m_reserved.load() && _ready(c)) {
+            m_committed.compare_exchange_weak(c, c + 1);
+        }
+    }
+
+    /* a reserved slot whose segment its writer has not allocated yet is not ready either */
+    bool _ready(std::size_t did) const noexcept {
+        auto [s, off] = _segment_of(did >> DenseBlock::N);
+        DenseBlock *seg = m_segments[s].load(std::memory_order_acquire);
+        return seg && seg[off].ready[did & ((1 << DenseBlock::N) - 1)].load();
+    }
+
+    /* thread-safe; the element becomes visible to readers once every earlier push_back
+     * has finished too */
+    template <class ...Args>
+    Id emplace_back(Args &&...args) {
+        std::size_t did = m_reserved.fetch_add(1, std::memory_order_relaxed);
+        DenseBlock &blk = _block_for_write(did >> DenseBlock::N);
+        std::size_t blkoff = did & ((1 << DenseBlock::N) - 1);
+        blk.vals.construct_at(blkoff, std::forward<Args>(args)...);
+        blk.ready[blkoff].store(true);
+        _advance_committed();
+        return static_cast<Id>(did);
+    }
+
+    Id push_back(T val) {
+        return emplace_back(std::move(val));
+    }
+
+    /* allocates the segments for n slots ahead, keeping allocation off the append path */
+    void reserve(std::size_t n) {
+        for (std::size_t blknr = 0; (blknr << DenseBlock::N) < n; ) {
+            auto [s, off] = _segment_of(blknr);
+            _block_for_write(blknr);
+            blknr += (std::size_t(1) << s) - off;
+        }
+    }
+
+    /* number of committed elements, the ids [0, size()) can be read */
+    [[nodiscard]] std::size_t size() const noexcept {
+        return m_committed.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] bool contains(Id id) const noexcept {
+        return (std::size_t)id < size();
+    }
+
+    [[nodiscard]] T const *at(Id id) const noexcept {
+        if (!contains(id)) {
+            return nullptr;
+        }
+        return &_block((std::size_t)id >> DenseBlock::N).vals[(std::size_t)id & ((1 << DenseBlock::N) - 1)];
+    }
+
+    /* mutable access, the caller keeps writers of the same element apart */
+    [[nodiscard]] T *at(Id id) noexcept {
+        return const_cast<T *>(std::as_const(*this).at(id));
+    }
+
+    /* fn(id, val) over the prefix committed when the call starts */
+    template <class Fn>
+    void foreach(Fn &&fn) const {
+        _foreach_range(0, size(), fn);
+    }
+
+    template <class Fn>
+    void _foreach_range(std::size_t begin, std::size_t end, Fn &fn) const {
+        for (std::size_t did = begin; did < end; ) {
+            DenseBlock &blk = _block(did >> DenseBlock::N);
+            std::size_t blkoff = did & ((1 << DenseBlock::N) - 1);
+            std::size_t nblk = std::min<std::size_t>(end - did, (1 << DenseBlock::N) - blkoff);
+            for (std::size_t k = 0; k != nblk; k++) {
+                fn(static_cast<Id>(did + k), std::as_const(blk.vals[blkoff + k]));
+            }
+            did += nblk;
+        }
+    }
+
+    /* fn(id, val) over elements committed since a previous size(), e.g. for a consumer
+     * that keeps a cursor while producers keep appending; returns the new cursor */
+    template <class Fn>
+    std::size_t foreach_since(std::size_t cursor, Fn &&fn) const {
+        std::size_t end = size();
+        _foreach_range(cursor, end, fn);
+        return end;
+    }
+
+    /* foreach over the committed prefix with whole blocks spread over pool */
+    template <class Pool, class Fn>
+    void parallel_foreach(Pool &pool, Fn &&fn, std::size_t chunk = 1) const {
+        const std::size_t n = size();
+        pool.parallel_for((n + (1 << DenseBlock::N) - 1) >> DenseBlock::N, chunk, [&] (std::size_t begin, std::size_t end) {
+            _foreach_range(begin << DenseBlock::N, std::min(n, end << DenseBlock::N), fn);
+        });
+    }
+
+    /* not thread-safe: destroys all elements, keeping the segments for reuse */
+    void clear() noexcept {
+        const std::size_t n = m_reserved.load(std::memory_order_relaxed);
+        for (std::size_t did = 0; did != n; did++) {
+            DenseBlock &blk = _block(did >> DenseBlock::N);
+            std::size_t blkoff = did & ((1 << DenseBlock::N) - 1);
+            blk.vals.destroy_at(blkoff);
+            blk.ready[blkoff].store(false, std::memory_order_relaxed);
+        }
+        m_reserved.store(0, std::memory_order_relaxed);
+        m_committed.store(0, std::memory_order_relaxed);
+    }
+
+    static constexpr std::size_t block_size() noexcept {
+        return DenseBlock::N;
+    }
+};
+
+}
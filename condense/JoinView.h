@@ -0,0 +1,173 @@
+#pragma once
+
+#include <tuple>
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+namespace condense {
+
+/* inner join of SparseVecs keyed by the same ids: walks the dense blocks of the smallest
+ * one and probes the rest, prefetching their index slots a few ids ahead so the probes
+ * overlap instead of missing one after another; fn(id, a, b, ...) gets references in
+ * argument order whichever container drives. through a const view every reference is
+ * const and nothing is stamped, so it is safe to run from several workers at once;
+ * through a mutable view the containers passed non-const get mutable references, and
+ * with TrackChanges foreach stamps each joined entry as their mutable at would, while
+ * parallel_foreach stamps them whole as their mutable foreach does */
+template <class ...Vecs>
+struct JoinView {
+    static_assert(sizeof...(Vecs) != 0, "join of nothing");
+
+    static constexpr std::size_t prefetch_distance = 16;
+
+    using id_type = typename std::remove_const_t<std::tuple_element_t<0, std::tuple<Vecs...>>>::id_type;
+
+    /* whether container I is written through by the mutable foreach, and stamped */
+    template <std::size_t I>
+    static constexpr bool _writes = !std::is_const_v<std::tuple_element_t<I, std::tuple<Vecs...>>>;
+
+    template <std::size_t I>
+    static constexpr bool _stamps = _writes<I> && std::remove_const_t<std::tuple_element_t<I, std::tuple<Vecs...>>>::track_changes;
+
+    std::tuple<Vecs &...> m_vecs;
+
+    explicit JoinView(Vecs &...vecs) noexcept : m_vecs(vecs...) {}
+
+    /* index of the container with the fewest elements */
+    std::size_t driver() const noexcept {
+        std::size_t best = 0, best_size = static_cast<std::size_t>(-1);
+        [&] <std::size_t ...Is> (std::index_sequence<Is...>) {
+            ((std::get<Is>(m_vecs).size() < best_size
+              ? (best = Is, best_size = std::get<Is>(m_vecs).size()) : 0), ...);
+        }(std::index_sequence_for<Vecs...>{});
+        return best;
+    }
+
+    enum class _access {
+        read,
+        write,           /* stamping each joined entry */
+        write_unstamped, /* the caller stamps afterwards */
+    };
+
+    /* the reference fn gets to the match p of container I, for the driver K at dense id
+     * did; a probed container that tracks changes is looked up again through its mutable
+     * at, so only the entries actually joined are stamped */
+    template <_access Access, std::size_t I, std::size_t K, class T>
+    decltype(auto) _ref(T const *p, id_type id, std::size_t did) const {
+        if constexpr (Access == _access::read || !_writes<I>) {
+            return *p;
+        } else if constexpr (Access == _access::write && I != K && _stamps<I>) {
+            return *std::get<I>(m_vecs).at(id);
+        } else {
+            if constexpr (Access == _access::write && _stamps<I>) {
+                std::get<I>(m_vecs)._touch(did);
+            }
+            return const_cast<T &>(*p);
+        }
+    }
+
+    /* fn(id, refs...) for the matches whose driver element lies in dense blocks [begin, end) */
+    template <std::size_t K, _access Access, class Fn>
+    void _drive_blocks(std::size_t begin, std::size_t end, Fn &fn) const {
+        auto &drv = std::as_const(std::get<K>(m_vecs));
+        const std::size_t n = drv.size();
+        const std::size_t bits = drv.block_size();
+        for (std::size_t blknr = begin; blknr != end; blknr++) {
+            auto &blk = drv.block(blknr);
+            const std::size_t nblk = std::min<std::size_t>(n - (blknr << bits), std::size_t(1) << bits);
+            for (std::size_t i = 0; i != nblk; i++) {
+                if (i + prefetch_distance < nblk) {
+                    id_type ahead = blk.inds[i + prefetch_distance];
+                    [&] <std::size_t ...Is> (std::index_sequence<Is...>) {
+                        ((Is != K ? std::get<Is>(m_vecs).prefetch(ahead) : void()), ...);
+                    }(std::index_sequence_for<Vecs...>{});
+                }
+                id_type id = blk.inds[i];
+                auto ptrs = [&] <std::size_t ...Is> (std::index_sequence<Is...>) {
+                    return std::make_tuple([&] {
+                        if constexpr (Is == K) {
+                            return &blk.vals[i];
+                        } else {
+                            return std::as_const(std::get<Is>(m_vecs)).at(id);
+                        }
+                    }()...);
+                }(std::index_sequence_for<Vecs...>{});
+                std::apply([&] (auto *...ps) {
+                    if ((ps && ...)) {
+                        [&] <std::size_t ...Is> (std::index_sequence<Is...>) {
+                            fn(id, _ref<Access, Is, K>(ps, id, (blknr << bits) + i)...);
+                        }(std::index_sequence_for<Vecs...>{});
+                    }
+                }, ptrs);
+            }
+        }
+    }
+
+    template <std::size_t K>
+    std::size_t _block_count() const noexcept {
+        auto &drv = std::get<K>(m_vecs);
+        std::size_t bits = drv.block_size();
+        return (drv.size() + (std::size_t(1) << bits) - 1) >> bits;
+    }
+
+    template <class Fn>
+    void _dispatch(Fn &&drive) const {
+        std::size_t k = driver();
+        [&] <std::size_t ...Is> (std::index_sequence<Is...>) {
+            ((k == Is ? (drive(std::integral_constant<std::size_t, Is>{}), true) : false) || ...);
+        }(std::index_sequence_for<Vecs...>{});
+    }
+
+    template <class Fn>
+    void foreach(Fn &&fn) const {
+        _dispatch([&] (auto k) {
+            _drive_blocks<k(), _access::read>(0, _block_count<k()>(), fn);
+        });
+    }
+
+    template <class Fn>
+    void foreach(Fn &&fn) {
+        _dispatch([&] (auto k) {
+            _drive_blocks<k(), _access::write>(0, _block_count<k()>(), fn);
+        });
+    }
+
+    /* foreach with the driver's dense blocks spread over pool, chunk blocks per unit;
+     * the joined containers must not be resized meanwhile */
+    template <class Pool, class Fn>
+    void parallel_foreach(Pool &pool, Fn &&fn, std::size_t chunk = 1) const {
+        _dispatch([&] (auto k) {
+            pool.parallel_for(_block_count<k()>(), chunk, [&] (std::size_t begin, std::size_t end) {
+                _drive_blocks<k(), _access::read>(begin, end, fn);
+            });
+        });
+    }
+
+    /* the workers cannot stamp single entries without racing on the version, so every
+     * written container that tracks changes is stamped whole afterwards */
+    template <class Pool, class Fn>
+    void parallel_foreach(Pool &pool, Fn &&fn, std::size_t chunk = 1) {
+        _dispatch([&] (auto k) {
+            pool.parallel_for(_block_count<k()>(), chunk, [&] (std::size_t begin, std::size_t end) {
+                _drive_blocks<k(), _access::write_unstamped>(begin, end, fn);
+            });
+        });
+        [&] <std::size_t ...Is> (std::index_sequence<Is...>) {
+            ([&] {
+                if constexpr (_stamps<Is>) {
+                    auto &vec = std::get<Is>(m_vecs);
+                    vec._stamp_all(vec._touch_all());
+                }
+            }(), ...);
+        }(std::index_sequence_for<Vecs...>{});
+    }
+};
+
+template <class ...Vecs>
+JoinView<Vecs...> join_view(Vecs &...vecs) noexcept {
+    return JoinView<Vecs...>(vecs...);
+}
+
+}
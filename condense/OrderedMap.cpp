@@ -0,0 +1,177 @@
+#include <random>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include "OrderedMap.h"
+#include "../conpool/ThreadPool.h"
+#include "../contest/test.h"
+
+namespace condense {
+
+TEST_BEGIN()
+
+using TestMap = OrderedMap<int, int>;
+using TestEntries = std::vector<std::pair<int, int>>;
+
+static TestEntries entries_of(TestMap const &m) {
+    return TestEntries(m.begin(), m.end());
+}
+
+/* whether m holds exactly the entries of model, in that order, and finds each of them;
+ * also checks that the tombstones stay a minority */
+static bool matches(TestMap const &m, TestEntries const &model) {
+    bool ok = m.size() == model.size() && entries_of(m) == model;
+    for (auto const &[k, v]: model) {
+        auto it = m.find(k);
+        ok &= it != m.end() && it->first == k && it->second == v && m.at(k) == v;
+    }
+    ok &= m.ntombs * 2 <= m.order.size();
+    return ok;
+}
+
+static std::size_t model_find(TestEntries const &model, int k) {
+    return std::find_if(model.begin(), model.end(), [k] (auto const &e) {
+        return e.first == k;
+    }) - model.begin();
+}
+
+TEST(OrderedMapChurn) {
+    std::mt19937 rng(4);
+    TestMap m;
+    TestEntries model;
+    bool ok = true;
+    std::size_t ncompacts = 0;
+    for (int step = 0; step < 30000; step++) {
+        int k = (int)(rng() % 600);
+        std::size_t pos = model_find(model, k);
+        std::size_t before = m.order.size();
+        switch (rng() % 4) {
+        case 0: case 1: {
+            int v = (int)rng();
+            ok &= m.insert(k, v).second == (pos == model.size());
+            if (pos == model.size()) {
+                model.emplace_back(k, v);
+            }
+        } break;
+        case 2: {
+            ok &= m.erase(k) == (pos != model.size());
+            if (pos != model.size()) {
+                model.erase(model.begin() + pos);
+            }
+        } break;
+        case 3: {
+            ok &= m.back_swap_erase(k) == (pos != model.size());
+            if (pos != model.size()) {
+                model[pos] = model.back();
+                model.pop_back();
+            }
+        } break;
+        }
+        ncompacts += m.order.size() + 1 < before;
+        ok &= !m.contains(-1 - k);
+        if (step % 1000 == 0) {
+            ok &= matches(m, model);
+        }
+    }
+    EXPECT_EQ(ok, true);
+    EXPECT_EQ(matches(m, model), true);
+    EXPECT_GT(ncompacts, 0);
+}
+
+TEST(OrderedMapEraseIterator) {
+    std::mt19937 rng(5);
+    TestMap m;
+    TestEntries model;
+    bool ok = true;
+    int next_key = 0;
+    for (int step = 0; step < 20000; step++) {
+        if (model.size() < 50 || rng() % 2) {
+            m.insert(next_key, -next_key);
+            model.emplace_back(next_key, -next_key);
+            next_key++;
+            continue;
+        }
+        std::size_t pos = rng() % model.size();
+        auto it = m.find(model[pos].first);
+        if (rng() % 2) {
+            /* the returned iterator is the entry that followed the erased one */
+            auto ret = m.erase(TestMap::const_iterator(it));
+            model.erase(model.begin() + pos);
+            ok &= pos == model.size() ? ret == m.end() : ret != m.end() && ret->first == model[pos].first;
+        } else {
+            /* the returned iterator is the former last entry, now in the erased position */
+            auto ret = m.back_swap_erase(TestMap::const_iterator(it));
+            if (pos + 1 == model.size()) {
+                model.pop_back();
+                ok &= ret == m.end();
+            } else {
+                model[pos] = model.back();
+                model.pop_back();
+                ok &= ret != m.end() && ret->first == model[pos].first;
+            }
+        }
+    }
+    EXPECT_EQ(ok, true);
+    EXPECT_EQ(matches(m, model), true);
+}
+
+/* a back_swap_erase that pushes the tombstones over half compacts order, and the returned
+ * iterator must follow the moved entry to its compacted position */
+TEST(OrderedMapBackSwapEraseCompacts) {
+    TestMap m;
+    for (int k = 0; k < 10; k++) {
+        m.insert(k, k * 10);
+    }
+    for (int k: {1, 2, 3, 4, 7}) {
+        m.erase(k);
+    }
+    auto ret = m.back_swap_erase(TestMap::const_iterator(m.find(5)));
+    EXPECT_EQ(m.ntombs, 0);
+    EXPECT_EQ(ret != m.end(), true);
+    EXPECT_EQ(ret->first, 9);
+    EXPECT_EQ(ret->second, 90);
+    EXPECT_EQ(matches(m, {{0, 0}, {9, 90}, {6, 60}, {8, 80}}), true);
+}
+
+TEST(OrderedMapParallelSort) {
+    std::mt19937 rng(6);
+    conpool::ThreadPool pool(4);
+    TestMap seq, par;
+    for (int i = 0; i < 50000; i++) {
+        int k = (int)rng(), v = (int)(rng() % 1000); /* plenty of equal values */
+        seq.insert(k, v);
+        par.insert(k, v);
+    }
+    for (int i = 0; i < 10000; i++) {
+        auto it = std::next(seq.begin(), rng() % 64);
+        int k = it->first;
+        seq.erase(k);
+        par.erase(k);
+    }
+
+    seq.sort_by_value();
+    par.sort_by_value(std::less<>{}, conpool::policy::par(pool));
+    TestEntries expect = entries_of(seq);
+    EXPECT_EQ(std::is_sorted(expect.begin(), expect.end(), [] (auto const &a, auto const &b) {
+        return a.second < b.second;
+    }), true);
+    EXPECT_EQ(matches(par, expect), true);
+
+    seq.sort_by_key(std::greater<>{});
+    par.sort_by_key(std::greater<>{}, conpool::policy::par(pool));
+    expect = entries_of(seq);
+    EXPECT_EQ(matches(par, expect), true);
+
+    /* the rebuilt index keeps working under further churn */
+    for (int i = 0; i < 1000; i++) {
+        int k = expect[i].first;
+        par.erase(k);
+        par.insert(k, i);
+    }
+    EXPECT_EQ(par.size(), expect.size());
+    EXPECT_EQ(par.at(expect[999].first), 999);
+}
+
+TEST_END()
+
+}
@@ -1,51 +1,296 @@
 #pragma once
 
-#include <unordered_map>
 #include <vector>
 #include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <functional>
+#include <algorithm>
+#include <type_traits>
+#include <atomic>
+#include "../conpool/policy.h"
+#include "../conpool/ParallelSort.h"
 
 namespace condense {
 
-template <class K, class V>
+/* insertion-ordered hash map laid out like a CPython dict: the entries live in order, and
+ * index is an open-addressing table of 32-bit positions into order, so a key is stored
+ * once and an insert allocates nothing but amortized vector growth. lookups probe index
+ * linearly from the key's home slot and compare keys through order; erased positions are
+ * removed by shifting the rest of their probe run back, so the table has no tombstones.
+ * order does: erase empties the entry in place in O(1), iteration skips the empty ones,
+ * and once they outnumber the live entries compact() squeezes them out. positions handed
+ * out by insert stay valid until then */
+template <class K, class V, class Hash = std::hash<K>, class KeyEqual = std::equal_to<K>>
 struct OrderedMap {
-    std::unordered_map<K, std::size_t> unomap;
-    std::vector<std::pair<K, V>> order;
+    static constexpr std::uint32_t npos = static_cast<std::uint32_t>(-1);
 
-    using value_type = typename decltype(order)::value_type;
-    using iterator = typename decltype(order)::iterator;
-    using const_iterator = typename decltype(order)::const_iterator;
+    std::vector<std::uint32_t> index; /* npos for an empty slot, size is 0 or a power of 2 */
+    std::vector<std::optional<std::pair<K, V>>> order; /* nullopt for an erased entry */
+    std::size_t ntombs = 0; /* erased entries still in order */
+    std::size_t head = 0;   /* no live entry before order[head] */
+    [[no_unique_address]] Hash hasher;
+    [[no_unique_address]] KeyEqual key_eq;
 
-    bool back_swap_erase(K const &k) noexcept {
-        if (auto it = unomap.find(k); it != unomap.end()) {
-            std::size_t id = it->second;
-            order[id] = std::move(order.back());
-            order.pop_back();
-            return true;
+    using value_type = std::pair<K, V>;
+
+    /* walks order skipping erased entries */
+    template <bool Const>
+    struct Iterator {
+        using Base = std::conditional_t<Const, typename decltype(order)::const_iterator, typename decltype(order)::iterator>;
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = OrderedMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<Const, value_type const *, value_type *>;
+        using reference = std::conditional_t<Const, value_type const &, value_type &>;
+
+        Base m_it;
+        Base m_end;
+
+        Iterator() = default;
+
+        Iterator(Base it, Base end) noexcept : m_it(it), m_end(end) {
+            _skip();
         }
-        return false;
+
+        /* iterator -> const_iterator */
+        template <bool C = Const> requires C
+        Iterator(Iterator<false> const &that) noexcept : m_it(that.m_it), m_end(that.m_end) {}
+
+        void _skip() noexcept {
+            while (m_it != m_end && !m_it->has_value()) {
+                ++m_it;
+            }
+        }
+
+        reference operator*() const noexcept {
+            return **m_it;
+        }
+
+        pointer operator->() const noexcept {
+            return &**m_it;
+        }
+
+        Iterator &operator++() noexcept {
+            ++m_it;
+            _skip();
+            return *this;
+        }
+
+        Iterator operator++(int) noexcept {
+            Iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        friend bool operator==(Iterator const &a, Iterator const &b) noexcept {
+            return a.m_it == b.m_it;
+        }
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    /* fibonacci hashing spreads weak hashes (e.g. the identity std::hash of integers) over
+     * the top bits, so strided keys do not pile up into one probe run */
+    std::size_t _home(K const &k) const noexcept {
+        std::uint64_t h = static_cast<std::uint64_t>(hasher(k)) * 0x9e3779b97f4a7c15ull;
+        return static_cast<std::size_t>(h >> 32) & (index.size() - 1);
     }
 
-    bool erase(K const &k) noexcept {
-        if (auto it = unomap.find(k); it != unomap.end()) {
-            std::size_t id = it->second;
-            order.erase(order.begin() + id);
-            return true;
+    /* slot holding k, or npos */
+    std::size_t _find_slot(K const &k) const noexcept {
+        if (index.empty()) {
+            return npos;
+        }
+        const std::size_t mask = index.size() - 1;
+        for (std::size_t i = _home(k); ; i = (i + 1) & mask) {
+            std::uint32_t id = index[i];
+            if (id == npos) {
+                return npos;
+            }
+            if (key_eq(order[id]->first, k)) {
+                return i;
+            }
+        }
+    }
+
+    /* slot holding position id, which must be live */
+    std::size_t _slot_of(std::size_t id) const noexcept {
+        const std::size_t mask = index.size() - 1;
+        std::size_t i = _home(order[id]->first);
+        while (index[i] != id) {
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
+
+    /* first empty slot of k's probe run, for a key known to be absent */
+    std::size_t _free_slot(K const &k) const noexcept {
+        const std::size_t mask = index.size() - 1;
+        std::size_t i = _home(k);
+        while (index[i] != npos) {
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
+
+    /* empties slot i and pulls later members of the probe run back over it */
+    void _erase_slot(std::size_t i) noexcept {
+        const std::size_t mask = index.size() - 1;
+        for (std::size_t j = (i + 1) & mask; index[j] != npos; j = (j + 1) & mask) {
+            std::size_t home = _home(order[index[j]]->first);
+            /* the entry at j may move to i only if i lies cyclically in [home, j) */
+            if (((j - home) & mask) >= ((j - i) & mask)) {
+                index[i] = index[j];
+                i = j;
+            }
+        }
+        index[i] = npos;
+    }
+
+    void _rehash(std::size_t nslots) {
+        index.assign(nslots, npos);
+        for (std::size_t id = 0; id != order.size(); id++) {
+            if (order[id]) {
+                index[_free_slot(order[id]->first)] = static_cast<std::uint32_t>(id);
+            }
+        }
+    }
+
+    /* keeps the table at most 2/3 full with n entries */
+    void _reserve_index(std::size_t n) {
+        std::size_t nslots = index.empty() ? 8 : index.size();
+        while (n * 3 > nslots * 2) {
+            nslots *= 2;
+        }
+        if (nslots != index.size()) {
+            _rehash(nslots);
+        }
+    }
+
+    void reserve(std::size_t n) {
+        _reserve_index(n);
+        order.reserve(n + ntombs);
+    }
+
+    /* drops the erased entries from order, keeping the order of the live ones; the index
+     * is renumbered in one pass through an old -> new position table, so no key is hashed
+     * again */
+    void compact() {
+        if (ntombs == 0) {
+            return;
+        }
+        std::vector<std::uint32_t> remap(order.size());
+        std::size_t live = 0;
+        for (std::size_t id = head; id != order.size(); id++) {
+            if (order[id]) {
+                remap[id] = static_cast<std::uint32_t>(live);
+                if (live != id) {
+                    order[live] = std::move(order[id]);
+                }
+                ++live;
+            }
+        }
+        order.resize(live);
+        for (std::uint32_t &slot: index) {
+            if (slot != npos) {
+                slot = remap[slot];
+            }
         }
-        return false;
+        ntombs = 0;
+        head = 0;
     }
 
-    iterator back_swap_erase(const_iterator it) noexcept {
-        unomap.erase(it->first);
-        std::size_t id = it - order.begin();
-        order[id] = std::move(order.back());
+    /* leaves a tombstone at position id, whose slot is already gone; trailing tombstones
+     * are popped right away and the rest compacted once they are the majority. compaction
+     * allocates, and if that throws the entry stays erased and the map uncompacted */
+    void _tombstone(std::size_t id) {
+        order[id].reset();
+        ++ntombs;
+        while (head != order.size() && !order[head]) {
+            ++head;
+        }
+        _trim_back();
+    }
+
+    /* keeps the last entry of order live and the tombstones a minority */
+    void _trim_back() {
+        while (!order.empty() && !order.back()) {
+            order.pop_back();
+            --ntombs;
+        }
+        head = std::min(head, order.size());
+        if (ntombs * 2 > order.size()) {
+            compact();
+        }
+    }
+
+    /* removes the entry indexed at slot i, moving the last live entry into its position;
+     * returns the slot of the moved entry, or npos if the last entry itself was erased */
+    std::size_t _back_swap_erase_at(std::size_t i) {
+        std::size_t id = index[i];
+        _erase_slot(i);
+        std::size_t last = order.size() - 1;
+        std::size_t moved = npos;
+        if (id != last) {
+            moved = _slot_of(last);
+            index[moved] = static_cast<std::uint32_t>(id);
+            order[id] = std::move(order.back());
+        }
         order.pop_back();
-        return begin() + (it - cbegin());
+        _trim_back();
+        return moved;
+    }
+
+    bool back_swap_erase(K const &k) {
+        std::size_t i = _find_slot(k);
+        if (i == npos) {
+            return false;
+        }
+        _back_swap_erase_at(i);
+        return true;
+    }
+
+    /* keeps the order of the remaining entries, amortized O(1) */
+    bool erase(K const &k) {
+        std::size_t i = _find_slot(k);
+        if (i == npos) {
+            return false;
+        }
+        std::size_t id = index[i];
+        _erase_slot(i);
+        _tombstone(id);
+        return true;
+    }
+
+    /* returns the iterator to the entry moved into the erased position, wherever
+     * compaction put it, or end() if the last entry was erased */
+    iterator back_swap_erase(const_iterator it) {
+        std::size_t id = it.m_it - order.cbegin();
+        std::size_t moved = _back_swap_erase_at(_slot_of(id));
+        return moved != npos ? _iter(index[moved]) : end();
+    }
+
+    /* returns the iterator to the entry after the erased one, wherever compaction put it */
+    iterator erase(const_iterator it) {
+        std::size_t id = it.m_it - order.cbegin();
+        std::size_t next_id = std::next(it).m_it - order.cbegin();
+        _erase_slot(_slot_of(id));
+        std::size_t next_slot = next_id != order.size() ? _slot_of(next_id) : npos;
+        _tombstone(id);
+        return next_slot != npos ? _iter(index[next_slot]) : end();
+    }
+
+    iterator _iter(std::size_t id) noexcept {
+        return iterator(order.begin() + id, order.end());
     }
 
-    iterator erase(const_iterator it) noexcept {
-        unomap.erase(it->first);
-        order.erase(it);
-        return begin() + (it - cbegin());
+    const_iterator _iter(std::size_t id) const noexcept {
+        return const_iterator(order.begin() + id, order.end());
     }
 
     std::pair<std::size_t, bool> insert(std::pair<K, V> kv) {
@@ -53,87 +298,163 @@ struct OrderedMap {
     }
 
     std::pair<std::size_t, bool> insert(K k, V v) {
-        std::size_t id = order.size();
-        auto [it, success] = unomap.emplace(std::as_const(k), id);
-        if (success) {
-            order.emplace_back(std::move(k), std::move(v));
-            return {id, true};
-        } else {
-            return {it->second, false};
+        if (std::size_t i = _find_slot(k); i != npos) {
+            return {index[i], false};
+        }
+        if (order.size() >= npos) {
+            compact();
+            if (order.size() >= npos) {
+                throw std::length_error("OrderedMap::insert");
+            }
         }
+        std::size_t id = order.size();
+        _reserve_index(size() + 1);
+        index[_free_slot(k)] = static_cast<std::uint32_t>(id);
+        order.emplace_back(std::in_place, std::move(k), std::move(v));
+        return {id, true};
     }
 
     std::size_t insert_or_assign(K k, V v) {
-        std::size_t id = order.size();
-        auto [it, success] = unomap.emplace(std::as_const(k), id);
-        if (success) {
-            order.emplace_back(std::move(k), std::move(v));
-            return id;
-        } else {
-            order[it->second] = std::move(v);
+        if (std::size_t i = _find_slot(k); i != npos) {
+            order[index[i]]->second = std::move(v);
+            return index[i];
         }
+        return insert(std::move(k), std::move(v)).first;
     }
 
     bool contains(K const &k) const noexcept {
-        return unomap.find(k) != unomap.end();
+        return _find_slot(k) != npos;
     }
 
-    auto find(K const &k) const noexcept {
-        auto it = unomap.find(k);
-        if (it == unomap.end()) {
-            return order.end();
+    const_iterator find(K const &k) const noexcept {
+        std::size_t i = _find_slot(k);
+        if (i == npos) {
+            return end();
         } else {
-            return order.begin() + it->second;
+            return _iter(index[i]);
+        }
+    }
+
+    iterator find(K const &k) noexcept {
+        std::size_t i = _find_slot(k);
+        if (i == npos) {
+            return end();
+        } else {
+            return _iter(index[i]);
+        }
+    }
+
+    auto &at(K const &k) {
+        std::size_t i = _find_slot(k);
+        if (i == npos) {
+            throw std::out_of_range("OrderedMap::at");
+        }
+        return order[index[i]]->second;
+    }
+
+    auto const &at(K const &k) const {
+        std::size_t i = _find_slot(k);
+        if (i == npos) {
+            throw std::out_of_range("OrderedMap::at");
         }
+        return order[index[i]]->second;
     }
 
-    auto find(K const &k) noexcept {
-        auto it = unomap.find(k);
-        if (it == unomap.end()) {
-            return order.end();
+    /* reorders the entries by comp(pair, pair), stably; positions handed out before are
+     * invalidated. with a Parallel policy the entries are sorted on its pool and the index
+     * is rebuilt in one parallel pass that claims empty slots with a CAS, which leaves
+     * every key in an unbroken probe run from its home slot, as a sequential rehash would */
+    template <class Comp, class Policy = conpool::policy::Sequential>
+    void sort(Comp comp, Policy policy = {}) {
+        compact();
+        auto by_entry = [&comp] (std::optional<value_type> const &a, std::optional<value_type> const &b) {
+            return comp(*a, *b);
+        };
+        if constexpr (std::is_same_v<Policy, conpool::policy::Sequential>) {
+            std::stable_sort(order.begin(), order.end(), by_entry);
+            _rehash(index.size());
         } else {
-            return order.begin() + it->second;
+            auto &pool = policy.pool;
+            conpool::parallel_sort(pool, order.begin(), order.end(), by_entry);
+            const std::size_t grain = 4096;
+            pool.parallel_for(index.size(), grain, [&] (std::size_t begin, std::size_t end) {
+                std::fill(index.begin() + begin, index.begin() + end, npos);
+            });
+            const std::size_t mask = index.size() - 1;
+            pool.parallel_for(order.size(), grain, [&] (std::size_t begin, std::size_t end) {
+                for (std::size_t id = begin; id != end; id++) {
+                    for (std::size_t i = _home(order[id]->first); ; i = (i + 1) & mask) {
+                        std::uint32_t expected = npos;
+                        if (std::atomic_ref<std::uint32_t>(index[i]).compare_exchange_strong(
+                                expected, static_cast<std::uint32_t>(id), std::memory_order_relaxed)) {
+                            break;
+                        }
+                    }
+                }
+            });
         }
     }
 
-    auto &at(K const &k) noexcept {
-        return order[unomap.at(k)].second;
+    template <class Comp = std::less<>, class Policy = conpool::policy::Sequential>
+    void sort_by_key(Comp comp = {}, Policy policy = {}) {
+        sort([&comp] (value_type const &a, value_type const &b) {
+            return comp(a.first, b.first);
+        }, policy);
     }
 
-    auto const &at(K const &k) const noexcept {
-        return order[unomap.at(k)].second;
+    template <class Comp = std::less<>, class Policy = conpool::policy::Sequential>
+    void sort_by_value(Comp comp = {}, Policy policy = {}) {
+        sort([&comp] (value_type const &a, value_type const &b) {
+            return comp(a.second, b.second);
+        }, policy);
     }
 
+    /* by position as returned from insert, which must still be live */
     auto &operator[](std::size_t id) noexcept {
-        return order[id].second;
+        return order[id]->second;
     }
 
     auto const &operator[](std::size_t id) const noexcept {
-        return order[id].second;
+        return order[id]->second;
+    }
+
+    std::size_t size() const noexcept {
+        return order.size() - ntombs;
+    }
+
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+
+    void clear() noexcept {
+        order.clear();
+        ntombs = 0;
+        head = 0;
+        std::fill(index.begin(), index.end(), npos);
     }
 
-    auto begin() noexcept {
-        return order.begin();
+    iterator begin() noexcept {
+        return _iter(head);
     }
 
-    auto end() noexcept {
-        return order.end();
+    iterator end() noexcept {
+        return _iter(order.size());
     }
 
-    auto begin() const noexcept {
-        return order.begin();
+    const_iterator begin() const noexcept {
+        return _iter(head);
     }
 
-    auto end() const noexcept {
-        return order.end();
+    const_iterator end() const noexcept {
+        return _iter(order.size());
     }
 
-    auto cbegin() const noexcept {
-        return order.cbegin();
+    const_iterator cbegin() const noexcept {
+        return begin();
     }
 
-    auto cend() const noexcept {
-        return order.cend();
+    const_iterator cend() const noexcept {
+        return end();
     }
 };
 
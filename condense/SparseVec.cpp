@@ -0,0 +1,417 @@
+#include <map>
+#include <set>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include "SparseVec.h"
+#include "JoinView.h"
+#include "../conpool/ThreadPool.h"
+#include "../contest/test.h"
+
+namespace condense {
+
+TEST_BEGIN()
+
+using TestVec = SparseVec<int, std::uint32_t>;
+using TestTrackedVec = SparseVec<int, std::uint32_t, std::size_t, std::allocator<int>, 8, 8, true>;
+
+/* whether v holds exactly model: foreach visits every id once and at finds each value */
+template <class Vec>
+static bool matches(Vec const &v, std::map<std::uint32_t, int> const &model) {
+    std::map<std::uint32_t, int> seen;
+    bool ok = (std::size_t)v.size() == model.size();
+    v.foreach([&] (std::uint32_t id, int const &val) {
+        ok &= seen.emplace(id, val).second;
+    });
+    ok &= seen == model;
+    for (auto const &[id, val]: model) {
+        int const *p = v.at(id);
+        ok &= p && *p == val && v.contains(id);
+    }
+    return ok;
+}
+
+TEST(SparseVecModel) {
+    std::mt19937 rng(1);
+    TestVec v;
+    std::map<std::uint32_t, int> model;
+    std::map<std::uint32_t, TestVec::Handle> handles;
+    std::vector<TestVec::Handle> stale;
+    bool ok = true;
+    for (int step = 0; step < 20000; step++) {
+        int val = (int)rng();
+        switch (rng() % 5) {
+        case 0: case 1: {
+            auto h = v.insert(val);
+            ok &= !model.count(h.id);
+            model[h.id] = val;
+            handles[h.id] = h;
+        } break;
+        case 2: {
+            std::uint32_t id = rng() % 4096;
+            auto [h, inserted] = v.insert_at(id, val);
+            ok &= inserted == !model.count(id) && h.id == id && h == handles.emplace(id, h).first->second;
+            model.emplace(id, val);
+        } break;
+        case 3: if (!model.empty()) {
+            auto it = std::next(model.begin(), rng() % model.size());
+            TestVec::Handle h = handles[it->first];
+            ok &= (rng() % 2 ? v.erase(h) : v.erase(it->first));
+            ok &= !v.erase(h) && !v.erase(it->first);
+            stale.push_back(h);
+            handles.erase(it->first);
+            model.erase(it);
+        } break;
+        case 4: {
+            std::uint32_t id = rng() % 8192;
+            int const *p = std::as_const(v).at(id);
+            ok &= model.count(id) ? p && *p == model[id] : !p;
+        } break;
+        }
+    }
+    EXPECT_EQ(ok, true);
+    EXPECT_EQ(matches(v, model), true);
+
+    /* a handle from before an erase never reaches the element that reuses its id */
+    bool rejected = true;
+    for (auto const &h: stale) {
+        rejected &= !v.contains(h) && !std::as_const(v).at(h);
+        auto live = handles.find(h.id);
+        if (live != handles.end()) {
+            rejected &= live->second.gen != h.gen && v.contains(live->second);
+        }
+    }
+    EXPECT_EQ(rejected, true);
+}
+
+TEST(SparseVecStaleHandle) {
+    TestVec v;
+    auto h1 = v.insert(1);
+    auto h2 = v.insert(2);
+    EXPECT_EQ(v.erase(h1), true);
+    auto h3 = v.insert(3);
+    EXPECT_EQ(h3.id, h1.id);
+    EXPECT_NE(h3.gen, h1.gen);
+    EXPECT_EQ(v.contains(h1), false);
+    EXPECT_EQ(v.at(h1) == nullptr, true);
+    EXPECT_EQ(v.erase(h1), false);
+    EXPECT_EQ(*v.at(h3), 3);
+    EXPECT_EQ(v.handle_of(h3.id) == h3, true);
+
+    v.clear();
+    EXPECT_EQ(v.contains(h2) || v.contains(h3), false);
+    auto h4 = v.insert(4);
+    EXPECT_EQ(v.contains(h4), true);
+    EXPECT_EQ(h4 == h2 || h4 == h3, false);
+}
+
+TEST(SparseVecWideIds) {
+    TestVec v;
+    std::map<std::uint32_t, int> model;
+    const std::uint32_t ids[] = {0xFFFFFFFEu, 0x80000000u, 0x7FFFFFFFu, 0x10000u, 12345, 0};
+    for (std::uint32_t id: ids) {
+        EXPECT_EQ(v.insert_at(id, (int)(id % 1000)).second, true);
+        model[id] = (int)(id % 1000);
+    }
+    EXPECT_EQ(v.insert_at(0xFFFFFFFEu, 7).second, false);
+    EXPECT_EQ(v.insert_at(TestVec::npos, 7).second, false);
+    EXPECT_EQ(v.contains(TestVec::npos), false);
+    EXPECT_EQ(matches(v, model), true);
+
+    /* fresh ids step over the claimed ones */
+    for (int i = 0; i < 300; i++) {
+        std::uint32_t id = v.push_back(-i);
+        EXPECT_EQ(model.emplace(id, -i).second, true);
+    }
+    EXPECT_EQ(matches(v, model), true);
+
+    EXPECT_EQ(v.erase(0xFFFFFFFEu), true);
+    EXPECT_EQ(v.erase(0x80000000u), true);
+    model.erase(0xFFFFFFFEu);
+    model.erase(0x80000000u);
+    EXPECT_EQ(v.contains(0xFFFFFFFEu), false);
+    EXPECT_EQ(matches(v, model), true);
+    EXPECT_EQ(v.insert_at(0xFFFFFFFEu, 9).second, true);
+    model[0xFFFFFFFEu] = 9;
+    EXPECT_EQ(matches(v, model), true);
+}
+
+TEST(SparseVecEraseBatch) {
+    std::mt19937 rng(2);
+    TestVec v;
+    std::map<std::uint32_t, int> model;
+    for (int i = 0; i < 1000; i++) {
+        model[v.push_back(i)] = i;
+    }
+    for (int round = 0; round < 20; round++) {
+        std::vector<std::uint32_t> ids;
+        std::set<std::uint32_t> live;
+        for (int i = 0; i < 60; i++) {
+            std::uint32_t id = rng() % 1200; /* some never inserted */
+            ids.push_back(id);
+            if (i % 3 == 0) {
+                ids.push_back(id); /* and some repeated */
+            }
+            if (model.count(id)) {
+                live.insert(id);
+            }
+        }
+        EXPECT_EQ(v.erase_batch(ids), live.size());
+        for (std::uint32_t id: live) {
+            model.erase(id);
+        }
+        EXPECT_EQ(matches(v, model), true);
+        for (int i = 0; i < 40; i++) {
+            model[v.push_back(round * 100 + i)] = round * 100 + i;
+        }
+    }
+    EXPECT_EQ(matches(v, model), true);
+}
+
+TEST(SparseVecCompactStep) {
+    std::mt19937 rng(3);
+    conpool::ThreadPool pool(4);
+    TestVec v;
+    std::map<std::uint32_t, int> model;
+    for (int i = 0; i < 2000; i++) {
+        model[v.push_back(i)] = i;
+    }
+    for (int i = 0; i < 700; i++) {
+        auto it = std::next(model.begin(), rng() % model.size());
+        v.erase(it->first);
+        model.erase(it);
+    }
+    for (int i = 0; i < 300; i++) {
+        auto [h, inserted] = v.insert_at(rng() % 5000, i);
+        if (inserted) {
+            model[h.id] = i;
+        }
+    }
+
+    /* descending ids, so that nearly every element has to move */
+    v.compact_begin(pool, [] (std::uint32_t id, int const &) {
+        return ~id;
+    });
+    EXPECT_EQ(v.compacting(), true);
+    std::size_t steps = 1;
+    while (!v.compact_step(1)) {
+        steps++;
+        EXPECT_EQ(matches(v, model), true); /* consistent between steps */
+    }
+    const std::size_t blk = std::size_t(1) << TestVec::block_size(); /* block_size is the shift */
+    EXPECT_EQ(steps, (model.size() + blk - 1) / blk);
+    EXPECT_EQ(v.compacting(), false);
+    EXPECT_EQ(matches(v, model), true);
+    std::vector<std::uint32_t> order;
+    v.foreach([&] (std::uint32_t id, int const &) {
+        order.push_back(id);
+    });
+    EXPECT_EQ(std::is_sorted(order.rbegin(), order.rend()), true);
+
+    /* an insert cancels a plan midway and leaves a consistent container */
+    v.compact_begin(pool, [] (std::uint32_t id, int const &) {
+        return id;
+    });
+    v.compact_step(1);
+    model[v.push_back(-1)] = -1;
+    EXPECT_EQ(v.compacting(), false);
+    EXPECT_EQ(v.compact_step(1), true);
+    EXPECT_EQ(matches(v, model), true);
+}
+
+TEST(SparseVecChangedSince) {
+    TestTrackedVec v;
+    std::map<std::uint32_t, int> model;
+    for (int i = 0; i < 1000; i++) {
+        model[v.push_back(i)] = i;
+    }
+    const auto v0 = v.version();
+    std::set<std::uint32_t> changed;
+    for (std::uint32_t id = 3; id < 1000; id += 97) {
+        *v.at(id) += 1;
+        model[id] += 1;
+        changed.insert(id);
+    }
+    for (int i = 0; i < 5; i++) {
+        std::uint32_t id = v.push_back(-i);
+        model[id] = -i;
+        changed.insert(id);
+    }
+    /* erasing moves the back element into the hole with its stamp */
+    v.erase(500);
+    model.erase(500);
+    changed.erase(500);
+    (void)std::as_const(v).at(10);
+
+    std::map<std::uint32_t, int> seen;
+    v.foreach_changed_since(v0, [&] (std::uint32_t id, int const &val) {
+        seen[id] = val;
+    });
+    std::map<std::uint32_t, int> expect;
+    for (std::uint32_t id: changed) {
+        expect[id] = model[id];
+    }
+    EXPECT_EQ(seen == expect, true);
+    EXPECT_EQ(matches(v, model), true);
+
+    std::size_t nlater = 0;
+    v.foreach_changed_since(v.version(), [&] (std::uint32_t, int const &) {
+        nlater++;
+    });
+    EXPECT_EQ(nlater, 0);
+}
+
+/* tearing the elements down, in compact, assignment or the destructor, is not a change */
+TEST(SparseVecDestroyKeepsVersion) {
+    using TrackedStrings = SparseVec<std::string, std::uint32_t, std::size_t, std::allocator<std::string>, 8, 8, true>;
+    conpool::ThreadPool pool(2);
+    TrackedStrings v, w;
+    for (int i = 0; i < 700; i++) {
+        v.push_back(std::string(40, char('a' + i % 26)));
+        w.push_back("w");
+    }
+    v.erase(3);
+    v.clear_dirty();
+    const auto ver = v.version();
+    v.compact_by_id(pool);
+    EXPECT_EQ(v.version(), ver);
+    std::size_t nchanged = 0, ndirty = 0;
+    v.foreach_changed_since(ver, [&] (std::uint32_t, std::string const &) {
+        nchanged++;
+    });
+    v.foreach_dirty_block([&] (auto const &...) {
+        ndirty++;
+    });
+    EXPECT_EQ(nchanged, 0);
+    EXPECT_EQ(ndirty, 0);
+
+    w = v;
+    EXPECT_EQ(w.version(), ver);
+    EXPECT_EQ(*std::as_const(w).at(4) == std::string(40, 'e'), true);
+    w = std::move(v);
+    EXPECT_EQ(w.version(), ver);
+    EXPECT_EQ(w.size(), 699);
+}
+
+/* with Id wider than DenseId, ids past the DenseId range go through the freelist intact */
+TEST(SparseVecFreelistWideIds) {
+    using WideIndex = SparseIndex<std::uint64_t, std::uint32_t>;
+    static_assert(sizeof(WideIndex::SparseBlock::Slot::next) == sizeof(std::uint64_t));
+    WideIndex index;
+    index.m_next = std::uint64_t(1) << 33;
+    std::uint64_t a = index.alloc_id(), b = index.alloc_id();
+    index.emplace(a, 0);
+    index.emplace(b, 1);
+    std::uint32_t did;
+    EXPECT_EQ(index.erase(a, did), true);
+    EXPECT_EQ(index.erase(b, did), true);
+    EXPECT_EQ(index.alloc_id(), b);
+    EXPECT_EQ(index.alloc_id(), a);
+    EXPECT_EQ(index.alloc_id(), b + 1);
+
+    SparseVec<int, std::uint64_t, std::uint32_t> v;
+    std::vector<decltype(v)::Handle> handles;
+    for (int i = 0; i < 1000; i++) {
+        handles.push_back(v.insert(i));
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        v.erase(handles[i]);
+    }
+    bool ok = true;
+    for (int i = 0; i < 500; i++) {
+        auto h = v.insert(-i);
+        ok &= h.id < 1000 && h.id % 2 == 0 && !v.contains(handles[h.id]);
+    }
+    EXPECT_EQ(ok, true);
+    EXPECT_EQ(v.size(), 1000);
+}
+
+/* entries of v stamped after version since */
+static std::size_t count_changed(TestTrackedVec const &v, TestTrackedVec::Version since) {
+    std::size_t n = 0;
+    v.foreach_changed_since(since, [&] (std::uint32_t, int const &) {
+        n++;
+    });
+    return n;
+}
+
+TEST(SparseVecJoinViewReadOnly) {
+    TestTrackedVec a, b;
+    for (int i = 0; i < 600; i++) {
+        a.push_back(i);
+        if (i % 3 == 0) {
+            b.push_back(-i);
+        }
+    }
+    const auto va = a.version(), vb = b.version();
+    long sum = 0, expect_sum = 0;
+    for (int i = 0; i < 200; i++) {
+        expect_sum += i - 3 * i; /* b's id i holds -3i */
+    }
+    std::size_t nmatch = 0;
+    auto const view = join_view(a, b);
+    view.foreach([&] (std::uint32_t, int const &x, int const &y) {
+        sum += x + y;
+        nmatch++;
+    });
+    EXPECT_EQ(nmatch, 200);
+    EXPECT_EQ(sum, expect_sum);
+    EXPECT_EQ(a.version(), va);
+    EXPECT_EQ(b.version(), vb);
+    EXPECT_EQ(count_changed(a, va) + count_changed(b, vb), 0);
+}
+
+/* a mutable join writes through the containers passed non-const and stamps exactly the
+ * joined entries, whether such a container drives or is probed */
+TEST(SparseVecJoinViewMutable) {
+    TestTrackedVec a, b;
+    TestVec c;
+    for (int i = 0; i < 600; i++) {
+        a.push_back(i);
+        c.push_back(1);
+        if (i % 3 == 0) {
+            b.push_back(i);
+        }
+    }
+    auto va = a.version(), vb = b.version();
+    /* b drives, a is probed */
+    join_view(a, std::as_const(b), c).foreach([&] (std::uint32_t, int &x, int const &y, int &z) {
+        x += y;
+        z = 0;
+    });
+    EXPECT_EQ(count_changed(a, va), 200);
+    EXPECT_EQ(b.version(), vb);
+    EXPECT_EQ(*std::as_const(a).at(10), 10 + 10 * 3);
+    EXPECT_EQ(*std::as_const(a).at(210), 210);
+    EXPECT_EQ(*std::as_const(c).at(10), 0);
+    EXPECT_EQ(*std::as_const(c).at(210), 1);
+
+    /* b drives and is written */
+    va = a.version();
+    vb = b.version();
+    join_view(std::as_const(a), b).foreach([&] (std::uint32_t id, int const &x, int &y) {
+        y = x - (int)id;
+    });
+    EXPECT_EQ(count_changed(b, vb), 200);
+    EXPECT_EQ(a.version(), va);
+    EXPECT_EQ(*std::as_const(b).at(10), 30);
+
+    /* in parallel every written container is stamped whole */
+    conpool::ThreadPool pool(4);
+    va = a.version();
+    vb = b.version();
+    join_view(a, std::as_const(b)).parallel_foreach(pool, [&] (std::uint32_t, int &x, int const &) {
+        x = -x;
+    });
+    EXPECT_EQ(count_changed(a, va), 600);
+    EXPECT_EQ(b.version(), vb);
+    EXPECT_EQ(*std::as_const(a).at(10), -40);
+    EXPECT_EQ(*std::as_const(a).at(300), 300);
+}
+
+TEST_END()
+
+}
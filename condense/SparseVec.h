@@ -1,8 +1,19 @@
 #pragma once
 
 #include <unordered_map>
+#include <memory>
 #include <utility>
 #include <vector>
+#include <cstdint>
+#include <type_traits>
+#include <tuple>
+#include <optional>
+#include <span>
+#include <ranges>
+#include <cstring>
+#include <bit>
+#include "../conpool/RadixSort.h"
+#include <algorithm>
 
 namespace condense {
 
@@ -12,6 +23,10 @@ union UninitArray {
 
     UninitArray() {}
 
+    /* the owner destroys live elements itself */
+    ~UninitArray() requires std::is_trivially_destructible_v<T> = default;
+    ~UninitArray() {}
+
     [[nodiscard]] constexpr T &operator[](std::size_t i) noexcept {
         return inner[i];
     }
@@ -32,114 +47,667 @@ union UninitArray {
     }
 };
 
-template <class T, class Id = std::size_t, class DenseId = std::size_t, class Alloc = std::allocator<T>>
-struct SparseVec {
+/* fixed-size blocks held by pointer and allocated through Alloc rebound to Block, so
+ * growing never relocates what lives inside them and T need not be copyable or even
+ * movable; a block is default-constructed on allocation and its owner tracks which of
+ * its elements are live */
+template <class Block, class Alloc>
+struct BlockVector {
+    using BlockAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Block>;
+    using PtrAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Block *>;
+
+    std::vector<Block *, PtrAlloc> m_blocks;
+    [[no_unique_address]] BlockAlloc m_alloc;
+
+    BlockVector() = default;
+
+    explicit BlockVector(Alloc const &alloc) noexcept
+    : m_blocks(PtrAlloc(alloc))
+    , m_alloc(alloc)
+    {}
+
+    BlockVector(BlockVector &&that) noexcept
+    : m_blocks(std::move(that.m_blocks))
+    , m_alloc(that.m_alloc)
+    {
+        that.m_blocks.clear();
+    }
+
+    BlockVector &operator=(BlockVector &&that) noexcept {
+        if (this != &that) {
+            resize(0);
+            m_blocks = std::move(that.m_blocks);
+            m_alloc = that.m_alloc;
+            that.m_blocks.clear();
+        }
+        return *this;
+    }
+
+    /* the owner copies the live elements itself */
+    BlockVector(BlockVector const &) = delete;
+    BlockVector &operator=(BlockVector const &) = delete;
+
+    ~BlockVector() noexcept {
+        resize(0);
+    }
+
+    void swap(BlockVector &that) noexcept {
+        std::swap(m_blocks, that.m_blocks);
+        std::swap(m_alloc, that.m_alloc);
+    }
+
+    BlockAlloc get_allocator() const noexcept {
+        return m_alloc;
+    }
+
+    /* blocks dropped by shrinking must not hold live elements anymore */
+    void resize(std::size_t n) {
+        using Traits = std::allocator_traits<BlockAlloc>;
+        while (m_blocks.size() > n) {
+            Traits::destroy(m_alloc, m_blocks.back());
+            Traits::deallocate(m_alloc, m_blocks.back(), 1);
+            m_blocks.pop_back();
+        }
+        m_blocks.reserve(n);
+        while (m_blocks.size() < n) {
+            Block *blk = Traits::allocate(m_alloc, 1);
+            Traits::construct(m_alloc, blk);
+            m_blocks.push_back(blk);
+        }
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept {
+        return m_blocks.size();
+    }
+
+    Block &operator[](std::size_t i) noexcept {
+        return *m_blocks[i];
+    }
+
+    Block const &operator[](std::size_t i) const noexcept {
+        return *m_blocks[i];
+    }
+};
+
+/* sparse id -> dense id table shared by the SparseVec flavours, i.e. the slot map half:
+ * ids freed by erase are recycled through an intrusive freelist threaded through the
+ * free slots, and each slot carries a generation bumped on erase, so a Handle {id, gen}
+ * held past the erase of its element is detected as stale instead of aliasing whatever
+ * reuses the id. the table is paged by 1 << SparseBits ids and pages are grouped into
+ * directories of 1 << SparseDirBits; both are allocated on first write, untouched ones
+ * alias a shared all-empty page or directory, so ids scattered over a 32-bit space cost
+ * memory in proportion to the pages actually written */
+template <class Id = std::size_t, class DenseId = std::size_t, class Alloc = std::allocator<DenseId>, std::size_t SparseBits = 8>
+struct SparseIndex {
+    static_assert(SparseBits >= 3, "a sparse page must fill at least one presence byte");
+
+    using Generation = std::uint32_t;
+
+    struct Handle {
+        Id id;
+        Generation gen;
+
+        friend bool operator==(Handle const &, Handle const &) = default;
+    };
+
     struct SparseBlock {
-        static const std::size_t N = 8;
-        DenseId dids[1 << N];
+        static const std::size_t N = SparseBits;
+        struct Slot {
+            /* the freelist link is an Id, which may be wider than DenseId */
+            union {
+                DenseId did; /* while live */
+                Id next;     /* next free id while the slot is free */
+            };
+            Generation gen;
+        };
+        Slot slots[1 << N];
         unsigned char bits[1 << (N - 3)];
-        SparseBlock() noexcept : bits{} {}
+        constexpr SparseBlock() noexcept : slots{}, bits{} {}
     };
 
-    struct DenseBlock {
-        static const std::size_t N = 8;
-        Id inds[1 << N];
-        UninitArray<T, (1 << N)> vals;
-        DenseBlock() noexcept {}
+    static const std::size_t SparseDirBits = 9;
+
+    struct SparseDir {
+        SparseBlock *pages[1 << SparseDirBits];
+        constexpr SparseDir() noexcept : pages{} {
+            for (SparseBlock *&page: pages) page = &s_empty_page;
+        }
     };
-    std::vector<SparseBlock, Alloc> m_sparse;
-    std::vector<DenseBlock, Alloc> m_dense;
-    DenseId m_densize;
-    Id m_spsize;
 
-    SparseVec() noexcept : m_densize(0), m_spsize(0) {}
+    using SparseAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<SparseBlock>;
+    using SparseDirAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<SparseDir>;
+    using SparseDirPtrAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<SparseDir *>;
+    using ClaimedAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<std::pair<Id const, Id>>;
+    using ClaimedMap = std::unordered_map<Id, Id, std::hash<Id>, std::equal_to<Id>, ClaimedAlloc>;
 
-    SparseVec(SparseVec &&that) noexcept
+    static constexpr Id npos = static_cast<Id>(-1);
+
+    /* read-only, never written through: pointers are compared against them before writing */
+    static inline SparseBlock s_empty_page{};
+    static inline SparseDir s_empty_dir{};
+
+    std::vector<SparseDir *, SparseDirPtrAlloc> m_sparse;
+    [[no_unique_address]] SparseAlloc m_page_alloc;
+    Id m_spsize;   /* high-water mark: ids below it have a slot, live or free */
+    Id m_next;     /* next fresh id; below it every id is live or on the freelist */
+    Id m_freehead; /* most recently freed id, npos when none */
+    ClaimedMap m_claimed; /* ids claimed while on the freelist -> their freelist successor */
+
+    SparseIndex() noexcept : m_spsize(0), m_next(0), m_freehead(npos) {}
+
+    template <class OtherAlloc>
+    explicit SparseIndex(OtherAlloc const &alloc) noexcept
+    : m_sparse(SparseDirPtrAlloc(alloc))
+    , m_page_alloc(alloc)
+    , m_spsize(0)
+    , m_next(0)
+    , m_freehead(npos)
+    , m_claimed(ClaimedAlloc(alloc))
+    {}
+
+    SparseIndex(SparseIndex &&that) noexcept
     : m_sparse(std::move(that.m_sparse))
-    , m_dense(std::move(that.m_dense))
-    , m_densize(std::exchange(that.m_densize, 0))
+    , m_page_alloc(that.m_page_alloc)
     , m_spsize(std::exchange(that.m_spsize, 0))
-    {}
+    , m_next(std::exchange(that.m_next, 0))
+    , m_freehead(std::exchange(that.m_freehead, npos))
+    , m_claimed(std::move(that.m_claimed))
+    {
+        that.m_claimed.clear();
+    }
 
-    SparseVec &operator=(SparseVec &&that) noexcept {
+    SparseIndex &operator=(SparseIndex &&that) noexcept {
         if (this != &that) {
+            _free_pages();
             m_sparse = std::move(that.m_sparse);
-            m_dense = std::move(that.m_dense);
-            m_densize = std::exchange(that.m_densize, 0);
+            m_page_alloc = that.m_page_alloc;
             m_spsize = std::exchange(that.m_spsize, 0);
+            m_next = std::exchange(that.m_next, 0);
+            m_freehead = std::exchange(that.m_freehead, npos);
+            m_claimed = std::move(that.m_claimed);
+            that.m_claimed.clear();
         }
         return *this;
     }
 
-    SparseVec(SparseVec const &that) noexcept
+    SparseIndex(SparseIndex const &that)
     : m_sparse(that.m_sparse)
-    , m_dense(that.m_dense)
-    , m_densize(that.m_densize)
+    , m_page_alloc(that.m_page_alloc)
     , m_spsize(that.m_spsize)
-    {}
+    , m_next(that.m_next)
+    , m_freehead(that.m_freehead)
+    , m_claimed(that.m_claimed)
+    {
+        _clone_pages();
+    }
 
-    SparseVec &operator=(SparseVec const &that) noexcept {
+    SparseIndex &operator=(SparseIndex const &that) {
         if (this != &that) {
+            _free_pages();
             m_sparse = that.m_sparse;
-            m_dense = that.m_dense;
-            m_densize = that.m_densize;
+            _clone_pages();
             m_spsize = that.m_spsize;
+            m_next = that.m_next;
+            m_freehead = that.m_freehead;
+            m_claimed = that.m_claimed;
         }
         return *this;
     }
 
-    void swap(SparseVec &that) noexcept {
-        if (this != &that) {
-            std::swap(m_sparse, that.m_sparse);
-            std::swap(m_dense, that.m_dense);
-            std::swap(m_densize, that.m_densize);
-            std::swap(m_spsize, that.m_spsize);
+    ~SparseIndex() noexcept {
+        _free_pages();
+    }
+
+    void swap(SparseIndex &that) noexcept {
+        std::swap(m_sparse, that.m_sparse);
+        std::swap(m_page_alloc, that.m_page_alloc);
+        std::swap(m_spsize, that.m_spsize);
+        std::swap(m_next, that.m_next);
+        std::swap(m_freehead, that.m_freehead);
+        m_claimed.swap(that.m_claimed);
+    }
+
+    SparseBlock *_new_page() {
+        using Traits = std::allocator_traits<SparseAlloc>;
+        SparseBlock *page = Traits::allocate(m_page_alloc, 1);
+        Traits::construct(m_page_alloc, page);
+        return page;
+    }
+
+    SparseDir *_new_dir() {
+        using Traits = std::allocator_traits<SparseDirAlloc>;
+        SparseDirAlloc alloc(m_page_alloc);
+        SparseDir *dir = Traits::allocate(alloc, 1);
+        Traits::construct(alloc, dir);
+        return dir;
+    }
+
+    void _free_pages() noexcept {
+        using Traits = std::allocator_traits<SparseAlloc>;
+        using DirTraits = std::allocator_traits<SparseDirAlloc>;
+        SparseDirAlloc dir_alloc(m_page_alloc);
+        for (SparseDir *&dir: m_sparse) {
+            if (dir == &s_empty_dir) {
+                continue;
+            }
+            for (SparseBlock *page: dir->pages) {
+                if (page != &s_empty_page) {
+                    Traits::destroy(m_page_alloc, page);
+                    Traits::deallocate(m_page_alloc, page, 1);
+                }
+            }
+            DirTraits::destroy(dir_alloc, dir);
+            DirTraits::deallocate(dir_alloc, dir, 1);
+            dir = &s_empty_dir;
+        }
+    }
+
+    /* after m_sparse was copied from another index, replace its pointers by copies */
+    void _clone_pages() {
+        for (SparseDir *&dir: m_sparse) {
+            if (dir == &s_empty_dir) {
+                continue;
+            }
+            SparseDir *dir_copy = _new_dir();
+            for (std::size_t i = 0; i != (1 << SparseDirBits); i++) {
+                if (dir->pages[i] != &s_empty_page) {
+                    dir_copy->pages[i] = _new_page();
+                    *dir_copy->pages[i] = *dir->pages[i];
+                }
+            }
+            dir = dir_copy;
+        }
+    }
+
+    /* page blknr, or s_empty_page if it was never written */
+    SparseBlock *_page(std::size_t blknr) const noexcept {
+        std::size_t dirnr = blknr >> SparseDirBits;
+        if (m_sparse.size() <= dirnr) {
+            return &s_empty_page;
+        }
+        return m_sparse[dirnr]->pages[blknr & ((1 << SparseDirBits) - 1)];
+    }
+
+    /* page blknr, allocating it (and its directory) if still shared with the empty ones */
+    SparseBlock &_page_for_write(std::size_t blknr) {
+        std::size_t dirnr = blknr >> SparseDirBits;
+        if (m_sparse.size() <= dirnr) {
+            m_sparse.resize(dirnr + 1, &s_empty_dir);
+        }
+        SparseDir *&dir = m_sparse[dirnr];
+        if (dir == &s_empty_dir) {
+            dir = _new_dir();
+        }
+        SparseBlock *&page = dir->pages[blknr & ((1 << SparseDirBits) - 1)];
+        if (page == &s_empty_page) {
+            page = _new_page();
+        }
+        return *page;
+    }
+
+    typename SparseBlock::Slot &slot(Id id) noexcept {
+        return _page((std::size_t)id >> SparseBlock::N)->slots[(std::size_t)id & ((1 << SparseBlock::N) - 1)];
+    }
+
+    typename SparseBlock::Slot const &slot(Id id) const noexcept {
+        return _page((std::size_t)id >> SparseBlock::N)->slots[(std::size_t)id & ((1 << SparseBlock::N) - 1)];
+    }
+
+    Id _next_free(Id id) const noexcept {
+        return slot(id).next;
+    }
+
+    bool _live(Id id) const noexcept {
+        DenseId did;
+        return read(id, did);
+    }
+
+    void _push_free(Id id) noexcept {
+        _page_for_write((std::size_t)id >> SparseBlock::N).slots[(std::size_t)id & ((1 << SparseBlock::N) - 1)].next = m_freehead;
+        m_freehead = id;
+    }
+
+    /* pops the freelist, skipping ids claimed while on it, or takes the next fresh id,
+     * skipping ids claimed ahead of it */
+    Id alloc_id() noexcept {
+        while (m_freehead != npos) {
+            Id id = m_freehead;
+            if (_live(id)) {
+                auto it = m_claimed.find(id);
+                m_freehead = it->second;
+                m_claimed.erase(it);
+                continue;
+            }
+            m_freehead = _next_free(id);
+            return id;
+        }
+        while (_live(m_next)) {
+            ++m_next;
+        }
+        Id id = m_next++;
+        m_spsize = std::max(m_spsize, m_next);
+        return id;
+    }
+
+    /* n consecutive fresh ids; a run broken by a claimed id is pushed onto the freelist
+     * and the search resumes after it */
+    Id alloc_range(std::size_t n) noexcept {
+        std::size_t first = m_next, k = 0;
+        while (k != n) {
+            if (_live(static_cast<Id>(first + k))) {
+                for (std::size_t i = first; i != first + k; i++) {
+                    _push_free(static_cast<Id>(i));
+                }
+                first += k + 1;
+                k = 0;
+            } else {
+                ++k;
+            }
         }
+        m_next = static_cast<Id>(first + n);
+        m_spsize = std::max(m_spsize, m_next);
+        return static_cast<Id>(first);
     }
 
-    void _sparse_emplace(Id id, DenseId did) noexcept {
-        std::size_t blknr = id >> SparseBlock::N;
-        std::size_t blkoff = id & ((1 << SparseBlock::N) - 1);
-        if (m_sparse.size() <= blknr) {
-            m_sparse.resize(blknr + 1);
+    /* reserves a caller-chosen id other than npos that is not live, in O(1). a free id
+     * below m_next sits somewhere in the singly linked freelist and its slot is about to
+     * hold a dense id instead of the link, so the link is kept in m_claimed until
+     * alloc_id reaches the id and skips it, or erase frees it again in place */
+    void claim_id(Id id) noexcept {
+        if (id < m_next) {
+            m_claimed.emplace(id, _next_free(id));
         }
-        SparseBlock &blk = m_sparse[blknr];
-        blk.dids[blkoff] = did;
+        m_spsize = std::max(m_spsize, static_cast<Id>(id + 1));
+    }
+
+    Generation emplace(Id id, DenseId did) noexcept {
+        std::size_t blknr = (std::size_t)id >> SparseBlock::N;
+        std::size_t blkoff = (std::size_t)id & ((1 << SparseBlock::N) - 1);
+        SparseBlock &blk = _page_for_write(blknr);
+        blk.slots[blkoff].did = did;
         blk.bits[blkoff >> 3] |= (1 << (blkoff & 7));
-        ++m_spsize;
+        return blk.slots[blkoff].gen;
+    }
+
+    /* emplace of ids [first, first + n) to dense ids [did, did + n), a page at a time */
+    void emplace_range(Id first, std::size_t n, DenseId did) noexcept {
+        std::size_t id = first, end = id + n;
+        while (id != end) {
+            std::size_t blkoff = id & ((1 << SparseBlock::N) - 1);
+            std::size_t nblk = std::min<std::size_t>(end - id, (1 << SparseBlock::N) - blkoff);
+            SparseBlock &blk = _page_for_write(id >> SparseBlock::N);
+            for (std::size_t i = blkoff; i != blkoff + nblk; i++) {
+                blk.slots[i].did = did++;
+                blk.bits[i >> 3] |= (1 << (i & 7));
+            }
+            id += nblk;
+        }
     }
 
-    bool _sparse_erase(Id id, DenseId &did) noexcept {
+    /* marks id free, bumps its generation and pushes it onto the freelist, unless it is
+     * still linked there from before a claim_id, or lies ahead of m_next */
+    bool erase(Id id, DenseId &did) noexcept {
         std::size_t blknr = (std::size_t)id >> SparseBlock::N;
         std::size_t blkoff = (std::size_t)id & ((1 << SparseBlock::N) - 1);
-        if (m_sparse.size() <= blknr)
+        /* an empty page has no bits set, so it is never written below */
+        SparseBlock &blk = *_page(blknr);
+        if (!(blk.bits[blkoff >> 3] & (1 << (blkoff & 7))))
             return false;
-        SparseBlock &blk = m_sparse[blknr];
-        blk.dids[blkoff] = did;
+        did = blk.slots[blkoff].did;
+        ++blk.slots[blkoff].gen;
         blk.bits[blkoff >> 3] &= ~(1 << (blkoff & 7));
-        --m_spsize;
+        if (id < m_next) {
+            auto it = m_claimed.empty() ? m_claimed.end() : m_claimed.find(id);
+            if (it != m_claimed.end()) {
+                blk.slots[blkoff].next = it->second;
+                m_claimed.erase(it);
+            } else {
+                blk.slots[blkoff].next = m_freehead;
+                m_freehead = id;
+            }
+        }
         return true;
     }
 
-    bool _sparse_read(Id id, DenseId &did) noexcept {
+    bool read(Id id, DenseId &did) const noexcept {
         std::size_t blknr = (std::size_t)id >> SparseBlock::N;
         std::size_t blkoff = (std::size_t)id & ((1 << SparseBlock::N) - 1);
-        if (m_sparse.size() <= blknr) {
-            return false;
-        }
-        SparseBlock &blk = m_sparse[blknr];
-        did = blk.dids[blkoff];
+        SparseBlock const &blk = *_page(blknr);
+        did = blk.slots[blkoff].did;
         return blk.bits[blkoff >> 3] & (1 << (blkoff & 7));
     }
 
-    void _sparse_update(Id id, DenseId did) noexcept {
-        std::size_t blknr = (std::size_t)id >> SparseBlock::N;
-        std::size_t blkoff = (std::size_t)id & ((1 << SparseBlock::N) - 1);
-        SparseBlock &blk = m_sparse[blknr];
-        blk.dids[blkoff] = did;
+    bool read(Handle h, DenseId &did) const noexcept {
+        std::size_t blknr = (std::size_t)h.id >> SparseBlock::N;
+        std::size_t blkoff = (std::size_t)h.id & ((1 << SparseBlock::N) - 1);
+        SparseBlock const &blk = *_page(blknr);
+        did = blk.slots[blkoff].did;
+        /* a live slot's generation only changes when it is freed */
+        return blk.slots[blkoff].gen == h.gen && (blk.bits[blkoff >> 3] & (1 << (blkoff & 7)));
+    }
+
+    void update(Id id, DenseId did) noexcept {
+        slot(id).did = did;
+    }
+
+    /* the current handle of a live id */
+    [[nodiscard]] Handle handle_of(Id id) const noexcept {
+        return {id, slot(id).gen};
+    }
+
+    /* pulls the slot of id toward the cache ahead of a read(id) */
+    void prefetch(Id id) const noexcept {
+        __builtin_prefetch(&slot(id));
+    }
+
+    [[nodiscard]] Id max_id() const noexcept {
+        return m_spsize;
+    }
+};
+
+/* dense storage of T in blocks of 1 << DenseBits, addressed through a SparseIndex; the
+ * elements stay packed (erase moves the back element into the hole), so foreach and
+ * foreach_block stream contiguous memory. with TrackChanges every entry carries the
+ * version of its last mutable access (insert, mutable at, mutable foreach) and every
+ * block the highest of them plus a dirty bit, see foreach_changed_since */
+template <class T, class Id = std::size_t, class DenseId = std::size_t, class Alloc = std::allocator<T>,
+          std::size_t SparseBits = 8, std::size_t DenseBits = 8, bool TrackChanges = false>
+struct SparseVec {
+    using Index = SparseIndex<Id, DenseId, typename std::allocator_traits<Alloc>::template rebind_alloc<DenseId>, SparseBits>;
+    using Generation = typename Index::Generation;
+    using Handle = typename Index::Handle;
+    using id_type = Id;
+    using value_type = T;
+
+    static constexpr Id npos = Index::npos;
+    static constexpr bool track_changes = TrackChanges;
+    using Version = std::uint64_t;
+
+    struct Stamps {
+        Version vers[1 << DenseBits];
+        Version maxver = 0;
+    };
+    struct NoStamps {};
+
+    struct DenseBlock {
+        static const std::size_t N = DenseBits;
+        Id inds[1 << N];
+        UninitArray<T, (1 << N)> vals;
+        [[no_unique_address]] std::conditional_t<TrackChanges, Stamps, NoStamps> stamps;
+        DenseBlock() noexcept {}
+    };
+    using allocator_type = Alloc;
+    using DenseStore = BlockVector<DenseBlock, Alloc>;
+
+    using IdAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Id>;
+    using DirtyAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<std::uint64_t>;
+    using DenseIdAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<DenseId>;
+
+    Index m_index;
+    DenseStore m_dense;
+    DenseId m_densize;
+    std::vector<Id, IdAlloc> m_compact_plan; /* ids in target dense order, see compact_begin */
+    DenseId m_compact_cursor;
+    Version m_version;       /* last version handed out, only advanced with TrackChanges */
+    Version m_clean_version; /* m_version at the last clear_dirty */
+    std::vector<std::uint64_t, DirtyAlloc> m_dirty; /* one bit per dense block */
+
+    SparseVec() noexcept : m_densize(0), m_compact_cursor(0), m_version(0), m_clean_version(0) {}
+
+    explicit SparseVec(Alloc const &alloc) noexcept
+    : m_index(alloc)
+    , m_dense(alloc)
+    , m_densize(0)
+    , m_compact_plan(IdAlloc(alloc))
+    , m_compact_cursor(0)
+    , m_version(0)
+    , m_clean_version(0)
+    , m_dirty(DirtyAlloc(alloc))
+    {}
+
+    allocator_type get_allocator() const noexcept {
+        return allocator_type(m_dense.get_allocator());
+    }
+
+    SparseVec(SparseVec &&that) noexcept
+    : m_index(std::move(that.m_index))
+    , m_dense(std::move(that.m_dense))
+    , m_densize(std::exchange(that.m_densize, 0))
+    , m_compact_plan(std::move(that.m_compact_plan))
+    , m_compact_cursor(std::exchange(that.m_compact_cursor, 0))
+    , m_version(std::exchange(that.m_version, 0))
+    , m_clean_version(std::exchange(that.m_clean_version, 0))
+    , m_dirty(std::move(that.m_dirty))
+    {}
+
+    SparseVec &operator=(SparseVec &&that) noexcept {
+        if (this != &that) {
+            _dense_destroy_all();
+            m_index = std::move(that.m_index);
+            m_dense = std::move(that.m_dense);
+            m_densize = std::exchange(that.m_densize, 0);
+            m_compact_plan = std::move(that.m_compact_plan);
+            m_compact_cursor = std::exchange(that.m_compact_cursor, 0);
+            m_version = std::exchange(that.m_version, 0);
+            m_clean_version = std::exchange(that.m_clean_version, 0);
+            m_dirty = std::move(that.m_dirty);
+        }
+        return *this;
+    }
+
+    SparseVec(SparseVec const &that)
+    : m_index(that.m_index)
+    , m_dense(that.m_dense.get_allocator())
+    , m_densize(0)
+    , m_compact_plan(that.m_compact_plan)
+    , m_compact_cursor(that.m_compact_cursor)
+    , m_version(that.m_version)
+    , m_clean_version(that.m_clean_version)
+    , m_dirty(that.m_dirty)
+    {
+        _dense_copy_from(that);
+    }
+
+    SparseVec &operator=(SparseVec const &that) {
+        if (this != &that) {
+            _dense_destroy_all();
+            m_densize = 0;
+            m_index = that.m_index;
+            _dense_copy_from(that);
+            m_compact_plan = that.m_compact_plan;
+            m_compact_cursor = that.m_compact_cursor;
+            m_version = that.m_version;
+            m_clean_version = that.m_clean_version;
+            m_dirty = that.m_dirty;
+        }
+        return *this;
+    }
+
+    ~SparseVec() noexcept {
+        _dense_destroy_all();
+    }
+
+    /* copy-constructs the elements of that into this, which holds none */
+    void _dense_copy_from(SparseVec const &that) {
+        m_dense.resize(that.m_dense.size());
+        for (std::size_t blknr = 0; (blknr << DenseBlock::N) < that.m_densize; blknr++) {
+            DenseBlock &blk = m_dense[blknr];
+            DenseBlock const &src = that.m_dense[blknr];
+            const std::size_t nblk = std::min<std::size_t>(that.m_densize - (blknr << DenseBlock::N), 1 << DenseBlock::N);
+            std::copy_n(src.inds, nblk, blk.inds);
+            for (std::size_t blkoff = 0; blkoff != nblk; blkoff++) {
+                blk.vals.construct_at(blkoff, src.vals[blkoff]);
+            }
+            if constexpr (TrackChanges) {
+                blk.stamps = src.stamps;
+            }
+        }
+        m_densize = that.m_densize;
+    }
+
+    void swap(SparseVec &that) noexcept {
+        if (this != &that) {
+            m_index.swap(that.m_index);
+            m_dense.swap(that.m_dense);
+            std::swap(m_densize, that.m_densize);
+            std::swap(m_compact_plan, that.m_compact_plan);
+            std::swap(m_compact_cursor, that.m_compact_cursor);
+            std::swap(m_version, that.m_version);
+            std::swap(m_clean_version, that.m_clean_version);
+            std::swap(m_dirty, that.m_dirty);
+        }
+    }
+
+    void _mark_dirty(std::size_t blknr) noexcept {
+        if (m_dirty.size() <= (blknr >> 6))
+            m_dirty.resize((blknr >> 6) + 1);
+        m_dirty[blknr >> 6] |= std::uint64_t(1) << (blknr & 63);
+    }
+
+    /* records version v on the entry at blkoff of block blknr */
+    void _stamp(std::size_t blknr, std::size_t blkoff, Version v) noexcept {
+        if constexpr (TrackChanges) {
+            DenseBlock &blk = m_dense[blknr];
+            blk.stamps.vers[blkoff] = v;
+            blk.stamps.maxver = std::max(blk.stamps.maxver, v);
+            if (v > m_clean_version) {
+                _mark_dirty(blknr);
+            }
+        }
+    }
+
+    void _touch(DenseId did) noexcept {
+        if constexpr (TrackChanges) {
+            _stamp((std::size_t)did >> DenseBlock::N, (std::size_t)did & ((1 << DenseBlock::N) - 1), ++m_version);
+        }
+    }
+
+    /* stamps the first n entries of blk with v; the dirty bits are set by _touch_all */
+    static void _stamp_block(DenseBlock &blk, std::size_t n, Version v) noexcept {
+        if constexpr (TrackChanges) {
+            std::fill_n(blk.stamps.vers, n, v);
+            blk.stamps.maxver = v;
+        }
+    }
+
+    /* a new version for a pass over every entry, with every block marked dirty up front
+     * so that parallel passes only write to the blocks they own */
+    Version _touch_all() noexcept {
+        if constexpr (TrackChanges) {
+            const std::size_t nblks = ((std::size_t)m_densize + (1 << DenseBlock::N) - 1) >> DenseBlock::N;
+            if (nblks) {
+                _mark_dirty(nblks - 1);
+                std::fill(m_dirty.begin(), m_dirty.begin() + ((nblks - 1) >> 6), ~std::uint64_t(0));
+                m_dirty[(nblks - 1) >> 6] |= ~std::uint64_t(0) >> (63 - ((nblks - 1) & 63));
+            }
+            return ++m_version;
+        } else {
+            return 0;
+        }
     }
 
     void _dense_push_back(Id id, T val) noexcept {
+        compact_cancel();
         std::size_t blknr = (std::size_t)m_densize >> DenseBlock::N;
         std::size_t blkoff = (std::size_t)m_densize & ((1 << DenseBlock::N) - 1);
         if (m_dense.size() <= blknr)
@@ -147,21 +715,26 @@ struct SparseVec {
         DenseBlock &blk = m_dense[blknr];
         blk.inds[blkoff] = id;
         blk.vals.construct_at(blkoff, std::move(val));
+        _touch(m_densize);
         ++m_densize;
     }
 
     void _dense_pop_back() noexcept {
+        compact_cancel();
+        --m_densize;
         std::size_t bblknr = (std::size_t)m_densize >> DenseBlock::N;
         std::size_t bblkoff = (std::size_t)m_densize & ((1 << DenseBlock::N) - 1);
         DenseBlock &bblk = m_dense[bblknr];
         bblk.vals.destroy_at(bblkoff);
-        --m_densize;
     }
 
-    Id _dense_swap_erase_back(Id id) noexcept {
-        std::size_t blknr = (std::size_t)id >> DenseBlock::N;
-        std::size_t blkoff = (std::size_t)id & ((1 << DenseBlock::N) - 1);
+    /* moves the last element into did, destroys the vacated back slot, returns the moved id */
+    Id _dense_swap_erase_back(DenseId did) noexcept {
+        compact_cancel();
+        std::size_t blknr = (std::size_t)did >> DenseBlock::N;
+        std::size_t blkoff = (std::size_t)did & ((1 << DenseBlock::N) - 1);
         DenseBlock &blk = m_dense[blknr];
+        --m_densize;
         std::size_t bblknr = (std::size_t)m_densize >> DenseBlock::N;
         std::size_t bblkoff = (std::size_t)m_densize & ((1 << DenseBlock::N) - 1);
         DenseBlock &bblk = m_dense[bblknr];
@@ -170,76 +743,249 @@ struct SparseVec {
         bblk.vals.destroy_at(bblkoff);
         Id indb = bblk.inds[bblkoff];
         blk.inds[blkoff] = indb;
-        --m_densize;
+        if constexpr (TrackChanges) {
+            _stamp(blknr, blkoff, bblk.stamps.vers[bblkoff]);
+        }
         return indb;
     }
 
-    T &_dense_at(Id id) noexcept {
-        std::size_t blknr = (std::size_t)id >> DenseBlock::N;
-        std::size_t blkoff = (std::size_t)id & ((1 << DenseBlock::N) - 1);
+    /* through _impl_foreach, as the mutable foreach would stamp and bump the version
+     * (and may grow m_dirty) on the way out */
+    void _dense_destroy_all() noexcept {
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            _impl_foreach(*this, [] (Id, T &val) {
+                std::destroy_at(std::addressof(val));
+            });
+        }
+    }
+
+    Id _dense_id_at(DenseId did) const noexcept {
+        return m_dense[(std::size_t)did >> DenseBlock::N].inds[(std::size_t)did & ((1 << DenseBlock::N) - 1)];
+    }
+
+    T &_dense_at(DenseId did) noexcept {
+        std::size_t blknr = (std::size_t)did >> DenseBlock::N;
+        std::size_t blkoff = (std::size_t)did & ((1 << DenseBlock::N) - 1);
         DenseBlock &blk = m_dense[blknr];
         return blk.vals[blkoff];
     }
 
-    T const &_dense_at(Id id) const noexcept {
-        std::size_t blknr = (std::size_t)id >> DenseBlock::N;
-        std::size_t blkoff = (std::size_t)id & ((1 << DenseBlock::N) - 1);
-        DenseBlock &blk = m_dense[blknr];
+    T const &_dense_at(DenseId did) const noexcept {
+        std::size_t blknr = (std::size_t)did >> DenseBlock::N;
+        std::size_t blkoff = (std::size_t)did & ((1 << DenseBlock::N) - 1);
+        DenseBlock const &blk = m_dense[blknr];
         return blk.vals[blkoff];
     }
 
+    /* ids may be recycled from erased elements, use insert for a stale-safe handle */
     Id push_back(T val) noexcept {
-        Id id = m_spsize;
+        return insert(std::move(val)).id;
+    }
+
+    Handle insert(T val) noexcept {
+        Id id = m_index.alloc_id();
         DenseId did = m_densize;
-        _sparse_emplace(id, did);
+        Generation gen = m_index.emplace(id, did);
         _dense_push_back(id, std::move(val));
-        return id;
+        return {id, gen};
+    }
+
+    /* inserts under a caller-chosen id, e.g. from a 32-bit key space; fails and returns
+     * the existing handle if id is taken. push_back keeps recycling erased ids and steps
+     * over claimed ones. npos is reserved as the freelist terminator and is rejected with
+     * the handle {npos, 0} */
+    std::pair<Handle, bool> insert_at(Id id, T val) noexcept {
+        if (id == npos) {
+            return {{npos, 0}, false};
+        }
+        DenseId did;
+        if (m_index.read(id, did)) {
+            return {handle_of(id), false};
+        }
+        m_index.claim_id(id);
+        Generation gen = m_index.emplace(id, m_densize);
+        _dense_push_back(id, std::move(val));
+        return {{id, gen}, true};
+    }
+
+    /* appends copies of vals under fresh consecutive ids, returned as a range; the dense
+     * array grows once and is filled a block at a time, by memcpy if T allows it */
+    std::ranges::iota_view<Id, Id> push_back_range(std::span<T const> vals) noexcept {
+        compact_cancel();
+        const std::size_t n = vals.size();
+        const Id first = m_index.alloc_range(n);
+        m_index.emplace_range(first, n, m_densize);
+        const std::size_t newsize = (std::size_t)m_densize + n;
+        const std::size_t nblks = (newsize + (1 << DenseBlock::N) - 1) >> DenseBlock::N;
+        if (m_dense.size() < nblks)
+            m_dense.resize(nblks);
+        for (std::size_t i = 0, did = m_densize; i != n; ) {
+            DenseBlock &blk = m_dense[did >> DenseBlock::N];
+            std::size_t blkoff = did & ((1 << DenseBlock::N) - 1);
+            std::size_t nblk = std::min<std::size_t>(n - i, (1 << DenseBlock::N) - blkoff);
+            if constexpr (std::is_trivially_copyable_v<T>) {
+                std::memcpy(&blk.vals[blkoff], vals.data() + i, nblk * sizeof(T));
+            } else {
+                for (std::size_t k = 0; k != nblk; k++) {
+                    blk.vals.construct_at(blkoff + k, vals[i + k]);
+                }
+            }
+            for (std::size_t k = 0; k != nblk; k++) {
+                blk.inds[blkoff + k] = static_cast<Id>(first + i + k);
+            }
+            if constexpr (TrackChanges) {
+                Version v = m_version + 1;
+                std::fill_n(blk.stamps.vers + blkoff, nblk, v);
+                blk.stamps.maxver = v;
+                _mark_dirty(did >> DenseBlock::N);
+            }
+            i += nblk;
+            did += nblk;
+        }
+        m_densize = static_cast<DenseId>(newsize);
+        if constexpr (TrackChanges) {
+            ++m_version;
+        }
+        return std::views::iota(first, static_cast<Id>(first + n));
+    }
+
+    /* the current handle of a live id */
+    [[nodiscard]] Handle handle_of(Id id) const noexcept {
+        return m_index.handle_of(id);
     }
 
     [[nodiscard]] T *at(Id id) noexcept {
         DenseId did;
-        if (!_sparse_read(id, did)) {
+        if (!m_index.read(id, did)) {
             return nullptr;
         }
+        _touch(did);
         return &_dense_at(did);
     }
 
     [[nodiscard]] T const *at(Id id) const noexcept {
         DenseId did;
-        if (!_sparse_read(id, did)) {
+        if (!m_index.read(id, did)) {
+            return nullptr;
+        }
+        return &_dense_at(did);
+    }
+
+    [[nodiscard]] T *at(Handle h) noexcept {
+        DenseId did;
+        if (!m_index.read(h, did)) {
+            return nullptr;
+        }
+        _touch(did);
+        return &_dense_at(did);
+    }
+
+    [[nodiscard]] T const *at(Handle h) const noexcept {
+        DenseId did;
+        if (!m_index.read(h, did)) {
             return nullptr;
         }
         return &_dense_at(did);
     }
 
+    /* issue a few ids ahead of at(id) to overlap the index misses of a random probe */
+    void prefetch(Id id) const noexcept {
+        m_index.prefetch(id);
+    }
+
     [[nodiscard]] bool contains(Id id) const noexcept {
         DenseId did;
-        return _sparse_read(id, did);
+        return m_index.read(id, did);
+    }
+
+    [[nodiscard]] bool contains(Handle h) const noexcept {
+        DenseId did;
+        return m_index.read(h, did);
     }
 
+    /* erases the last element in dense order */
     void pop_back() noexcept {
         DenseId did;
-        _sparse_erase(m_densize - 1, did);
+        m_index.erase(_dense_id_at(m_densize - 1), did);
         _dense_pop_back();
     }
 
     bool erase(Id id) noexcept {
-        if (id + 1 == m_densize && m_densize != 0) {
-            pop_back();
-            return true;
-        }
         DenseId did;
-        if (!_sparse_erase(id, did)) {
+        if (!m_index.erase(id, did)) {
             return false;
         }
-        Id indb = _dense_swap_erase_back(id);
-        _sparse_update(indb, did);
+        if (did + 1 == m_densize) {
+            _dense_pop_back();
+        } else {
+            Id indb = _dense_swap_erase_back(did);
+            m_index.update(indb, did);
+        }
         return true;
     }
 
+    bool erase(Handle h) noexcept {
+        if (!contains(h)) {
+            return false;
+        }
+        return erase(h.id);
+    }
+
+    /* erases every live id in ids (others are skipped), returns how many were erased.
+     * the holes are sorted, then one pass down the tail moves each surviving tail element
+     * into the lowest open hole, so no element is moved twice. the scratch list of holes
+     * comes from the container's allocator, and is reserved before anything is erased so
+     * a bad_alloc leaves the container untouched */
+    std::size_t erase_batch(std::span<Id const> ids) {
+        std::vector<DenseId, DenseIdAlloc> holes{DenseIdAlloc(get_allocator())};
+        holes.reserve(ids.size());
+        compact_cancel();
+        for (Id id: ids) {
+            DenseId did;
+            if (m_index.erase(id, did)) {
+                holes.push_back(did);
+            }
+        }
+        std::sort(holes.begin(), holes.end());
+        const std::size_t nholes = holes.size();
+        const DenseId newsize = m_densize - static_cast<DenseId>(nholes);
+        std::size_t back = nholes, front = 0;
+        for (DenseId src = m_densize; src-- != newsize; ) {
+            DenseBlock &sblk = m_dense[(std::size_t)src >> DenseBlock::N];
+            std::size_t soff = (std::size_t)src & ((1 << DenseBlock::N) - 1);
+            if (back != 0 && holes[back - 1] == src) {
+                --back;
+                sblk.vals.destroy_at(soff);
+                continue;
+            }
+            DenseId dst = holes[front++];
+            DenseBlock &dblk = m_dense[(std::size_t)dst >> DenseBlock::N];
+            std::size_t doff = (std::size_t)dst & ((1 << DenseBlock::N) - 1);
+            dblk.vals.destroy_at(doff);
+            dblk.vals.construct_at(doff, std::move(sblk.vals[soff]));
+            sblk.vals.destroy_at(soff);
+            dblk.inds[doff] = sblk.inds[soff];
+            m_index.update(dblk.inds[doff], dst);
+            if constexpr (TrackChanges) {
+                _stamp((std::size_t)dst >> DenseBlock::N, doff, sblk.stamps.vers[soff]);
+            }
+        }
+        m_densize = newsize;
+        return nholes;
+    }
+
+    /* destroys all elements; every id goes onto the freelist with its generation bumped,
+     * so handles from before the clear stay stale */
+    void clear() noexcept {
+        while (m_densize != 0) {
+            pop_back();
+        }
+    }
+
     template <class Fn>
     void foreach(Fn &&fn) noexcept {
-        return _impl_foreach(*this, std::forward<Fn>(fn));
+        _impl_foreach(*this, std::forward<Fn>(fn));
+        _stamp_all(_touch_all());
     }
 
     template <class Fn>
@@ -269,7 +1015,17 @@ struct SparseVec {
 
     template <class Fn>
     void foreach_block(Fn &&fn) noexcept {
-        return _impl_foreach_block(*this, std::forward<Fn>(fn));
+        _impl_foreach_block(*this, std::forward<Fn>(fn));
+        _stamp_all(_touch_all());
+    }
+
+    void _stamp_all(Version v) noexcept {
+        if constexpr (TrackChanges) {
+            const std::size_t n = m_densize;
+            for (std::size_t blknr = 0; (blknr << DenseBlock::N) < n; blknr++) {
+                _stamp_block(m_dense[blknr], std::min<std::size_t>(n - (blknr << DenseBlock::N), 1 << DenseBlock::N), v);
+            }
+        }
     }
 
     template <class Fn>
@@ -293,6 +1049,285 @@ struct SparseVec {
         }
     }
 
+    /* foreach_block with whole blocks spread over pool (any conpool thread pool), chunk
+     * blocks per scheduling unit; fn must be safe to call concurrently on distinct blocks */
+    template <class Pool, class Fn>
+    void parallel_foreach_block(Pool &pool, Fn &&fn, std::size_t chunk = 1) noexcept {
+        if constexpr (TrackChanges) {
+            const Version v = _touch_all();
+            return _impl_parallel_foreach_block(*this, pool, [&] (DenseBlock &blk, auto ...nrest) {
+                fn(blk, nrest...);
+                _stamp_block(blk, std::min<std::size_t>({nrest..., 1 << DenseBlock::N}), v);
+            }, chunk);
+        } else {
+            return _impl_parallel_foreach_block(*this, pool, std::forward<Fn>(fn), chunk);
+        }
+    }
+
+    template <class Pool, class Fn>
+    void parallel_foreach_block(Pool &pool, Fn &&fn, std::size_t chunk = 1) const noexcept {
+        return _impl_parallel_foreach_block(*this, pool, std::forward<Fn>(fn), chunk);
+    }
+
+    template <class Self, class Pool, class Fn>
+    static void _impl_parallel_foreach_block(Self &&self, Pool &pool, Fn &&fn, std::size_t chunk) noexcept {
+        const std::size_t nblks = (std::size_t)self.m_densize >> DenseBlock::N;
+        const std::size_t nrest = self.m_densize - (nblks << DenseBlock::N);
+        pool.parallel_for(nblks + (nrest != 0), chunk, [&] (std::size_t begin, std::size_t end) {
+            for (std::size_t blknr = begin; blknr != end; blknr++) {
+                auto &blk = self.m_dense[blknr];
+                if (blknr != nblks) {
+                    fn(blk);
+                } else {
+                    fn(blk, nrest);
+                }
+            }
+        });
+    }
+
+    template <class Pool, class Fn>
+    void parallel_foreach(Pool &pool, Fn &&fn, std::size_t chunk = 1) noexcept {
+        if constexpr (TrackChanges) {
+            const Version v = _touch_all();
+            return _impl_parallel_foreach_block(*this, pool, [&] (DenseBlock &blk, std::size_t nblk = 1 << DenseBlock::N) {
+                for (std::size_t blkoff = 0; blkoff != nblk; blkoff++) {
+                    fn(blk.inds[blkoff], blk.vals[blkoff]);
+                }
+                _stamp_block(blk, nblk, v);
+            }, chunk);
+        } else {
+            return _impl_parallel_foreach(*this, pool, std::forward<Fn>(fn), chunk);
+        }
+    }
+
+    template <class Pool, class Fn>
+    void parallel_foreach(Pool &pool, Fn &&fn, std::size_t chunk = 1) const noexcept {
+        return _impl_parallel_foreach(*this, pool, std::forward<Fn>(fn), chunk);
+    }
+
+    template <class Self, class Pool, class Fn>
+    static void _impl_parallel_foreach(Self &&self, Pool &pool, Fn &&fn, std::size_t chunk) noexcept {
+        const std::size_t n = self.m_densize;
+        pool.parallel_for((n + (1 << DenseBlock::N) - 1) >> DenseBlock::N, chunk, [&] (std::size_t begin, std::size_t end) {
+            for (std::size_t blknr = begin; blknr != end; blknr++) {
+                auto &blk = self.m_dense[blknr];
+                const std::size_t nblk = std::min<std::size_t>(n - (blknr << DenseBlock::N), 1 << DenseBlock::N);
+                for (std::size_t blkoff = 0; blkoff != nblk; blkoff++) {
+                    fn(blk.inds[blkoff], blk.vals[blkoff]);
+                }
+            }
+        });
+    }
+
+    /* folds map(id, val) over all elements with combine, starting from init; partials are
+     * per chunk of blocks and folded in dense order, so the result is deterministic */
+    template <class Pool, class R, class Map, class Combine>
+    R parallel_reduce(Pool &pool, R init, Map &&map, Combine &&combine, std::size_t chunk = 1) const noexcept {
+        const std::size_t n = m_densize;
+        return pool.parallel_reduce((n + (1 << DenseBlock::N) - 1) >> DenseBlock::N, chunk, std::move(init),
+                                    [&] (std::size_t begin, std::size_t end) {
+            std::optional<R> acc;
+            for (std::size_t blknr = begin; blknr != end; blknr++) {
+                auto &blk = m_dense[blknr];
+                const std::size_t nblk = std::min<std::size_t>(n - (blknr << DenseBlock::N), 1 << DenseBlock::N);
+                for (std::size_t blkoff = 0; blkoff != nblk; blkoff++) {
+                    if (acc) {
+                        acc.emplace(combine(std::move(*acc), map(blk.inds[blkoff], blk.vals[blkoff])));
+                    } else {
+                        acc.emplace(map(blk.inds[blkoff], blk.vals[blkoff]));
+                    }
+                }
+            }
+            return std::move(*acc);
+        }, combine);
+    }
+
+    /* dense ids sorted by key(id, val) (an unsigned integer, e.g. the id itself or a Morton
+     * code), computed on pool; equal keys keep their current relative order */
+    template <class Pool, class KeyFn>
+    std::vector<DenseId> _compact_order(Pool &pool, KeyFn &key) const {
+        using Key = std::decay_t<decltype(key(std::declval<Id>(), std::declval<T const &>()))>;
+        const std::size_t n = m_densize;
+        std::vector<Key> keys(n);
+        std::vector<DenseId> order(n);
+        pool.parallel_for((n + (1 << DenseBlock::N) - 1) >> DenseBlock::N, 1, [&] (std::size_t begin, std::size_t end) {
+            for (std::size_t blknr = begin; blknr != end; blknr++) {
+                auto &blk = m_dense[blknr];
+                const std::size_t base = blknr << DenseBlock::N;
+                const std::size_t nblk = std::min<std::size_t>(n - base, 1 << DenseBlock::N);
+                for (std::size_t blkoff = 0; blkoff != nblk; blkoff++) {
+                    keys[base + blkoff] = key(blk.inds[blkoff], blk.vals[blkoff]);
+                    order[base + blkoff] = static_cast<DenseId>(base + blkoff);
+                }
+            }
+        });
+        conpool::radix_sort_pairs(pool, keys.data(), order.data(), n);
+        return order;
+    }
+
+    /* re-sorts the dense array by key(id, val) in one go: elements are moved into fresh
+     * blocks in sorted order and every id's slot is rewritten in the same parallel pass */
+    template <class Pool, class KeyFn>
+    void compact(Pool &pool, KeyFn &&key) {
+        compact_cancel();
+        const std::size_t n = m_densize;
+        std::vector<DenseId> order = _compact_order(pool, key);
+        DenseStore dense(m_dense.get_allocator());
+        dense.resize(m_dense.size());
+        pool.parallel_for((n + (1 << DenseBlock::N) - 1) >> DenseBlock::N, 1, [&] (std::size_t begin, std::size_t end) {
+            for (std::size_t blknr = begin; blknr != end; blknr++) {
+                DenseBlock &dst = dense[blknr];
+                const std::size_t base = blknr << DenseBlock::N;
+                const std::size_t nblk = std::min<std::size_t>(n - base, 1 << DenseBlock::N);
+                for (std::size_t blkoff = 0; blkoff != nblk; blkoff++) {
+                    DenseId from = order[base + blkoff];
+                    DenseBlock &src = m_dense[(std::size_t)from >> DenseBlock::N];
+                    std::size_t srcoff = (std::size_t)from & ((1 << DenseBlock::N) - 1);
+                    Id id = src.inds[srcoff];
+                    dst.inds[blkoff] = id;
+                    dst.vals.construct_at(blkoff, std::move(src.vals[srcoff]));
+                    if constexpr (TrackChanges) {
+                        dst.stamps.vers[blkoff] = src.stamps.vers[srcoff];
+                        dst.stamps.maxver = std::max(dst.stamps.maxver, src.stamps.vers[srcoff]);
+                    }
+                    /* distinct ids have distinct slots, so these writes do not race */
+                    m_index.update(id, static_cast<DenseId>(base + blkoff));
+                }
+            }
+        });
+        _dense_destroy_all();
+        m_dense.swap(dense);
+        if constexpr (TrackChanges) {
+            m_dirty.clear();
+            for (std::size_t blknr = 0; (blknr << DenseBlock::N) < n; blknr++) {
+                if (m_dense[blknr].stamps.maxver > m_clean_version) {
+                    _mark_dirty(blknr);
+                }
+            }
+        }
+    }
+
+    /* restores ascending id order, so that iteration walks the sparse index linearly */
+    template <class Pool>
+    void compact_by_id(Pool &pool) {
+        compact(pool, [] (Id id, T const &) {
+            return static_cast<std::make_unsigned_t<Id>>(id);
+        });
+    }
+
+    /* plans an incremental compact: the target order is computed now, compact_step then
+     * moves elements into place a bounded number of blocks at a time, e.g. between frames.
+     * any insert or erase cancels the plan */
+    template <class Pool, class KeyFn>
+    void compact_begin(Pool &pool, KeyFn &&key) {
+        std::vector<DenseId> order = _compact_order(pool, key);
+        m_compact_plan.resize(order.size());
+        for (std::size_t i = 0; i != order.size(); i++) {
+            m_compact_plan[i] = _dense_id_at(order[i]);
+        }
+        m_compact_cursor = 0;
+    }
+
+    /* settles the next max_blocks dense blocks of the plan by swapping each planned element
+     * into its position, returns true once the plan is complete (or there is none) */
+    bool compact_step(std::size_t max_blocks = 1) noexcept {
+        const std::size_t n = m_compact_plan.size();
+        const std::size_t end = std::min<std::size_t>(n, m_compact_cursor + (max_blocks << DenseBlock::N));
+        for (std::size_t pos = m_compact_cursor; pos != end; pos++) {
+            Id id = m_compact_plan[pos];
+            DenseId did;
+            m_index.read(id, did);
+            if (did != pos) {
+                _dense_swap(static_cast<DenseId>(pos), did);
+            }
+        }
+        m_compact_cursor = static_cast<DenseId>(end);
+        if (end == n) {
+            compact_cancel();
+            return true;
+        }
+        return false;
+    }
+
+    [[nodiscard]] bool compacting() const noexcept {
+        return !m_compact_plan.empty();
+    }
+
+    void compact_cancel() noexcept {
+        m_compact_plan.clear();
+        m_compact_cursor = 0;
+    }
+
+    /* swaps the elements at two dense positions and fixes their slots */
+    void _dense_swap(DenseId a, DenseId b) noexcept {
+        DenseBlock &ablk = m_dense[(std::size_t)a >> DenseBlock::N];
+        DenseBlock &bblk = m_dense[(std::size_t)b >> DenseBlock::N];
+        std::size_t aoff = (std::size_t)a & ((1 << DenseBlock::N) - 1);
+        std::size_t boff = (std::size_t)b & ((1 << DenseBlock::N) - 1);
+        using std::swap;
+        swap(ablk.vals[aoff], bblk.vals[boff]);
+        swap(ablk.inds[aoff], bblk.inds[boff]);
+        m_index.update(ablk.inds[aoff], a);
+        m_index.update(bblk.inds[boff], b);
+        if constexpr (TrackChanges) {
+            swap(ablk.stamps.vers[aoff], bblk.stamps.vers[boff]);
+            _stamp((std::size_t)a >> DenseBlock::N, aoff, ablk.stamps.vers[aoff]);
+            _stamp((std::size_t)b >> DenseBlock::N, boff, bblk.stamps.vers[boff]);
+        }
+    }
+
+    /* the last version handed out; record it, then later pass it to foreach_changed_since */
+    [[nodiscard]] Version version() const noexcept requires TrackChanges {
+        return m_version;
+    }
+
+    /* visits fn(id, val) for the entries inserted or mutably accessed after version v,
+     * skipping whole blocks whose newest stamp is not past v. erasures are not reported,
+     * and an entry moved by erase or compaction keeps its stamp */
+    template <class Fn>
+    void foreach_changed_since(Version v, Fn &&fn) const noexcept requires TrackChanges {
+        const std::size_t n = m_densize;
+        for (std::size_t blknr = 0; (blknr << DenseBlock::N) < n; blknr++) {
+            DenseBlock const &blk = m_dense[blknr];
+            if (blk.stamps.maxver <= v) {
+                continue;
+            }
+            const std::size_t nblk = std::min<std::size_t>(n - (blknr << DenseBlock::N), 1 << DenseBlock::N);
+            for (std::size_t blkoff = 0; blkoff != nblk; blkoff++) {
+                if (blk.stamps.vers[blkoff] > v) {
+                    fn(blk.inds[blkoff], blk.vals[blkoff]);
+                }
+            }
+        }
+    }
+
+    [[nodiscard]] bool block_dirty(std::size_t blknr) const noexcept requires TrackChanges {
+        return (blknr >> 6) < m_dirty.size() && (m_dirty[blknr >> 6] >> (blknr & 63) & 1);
+    }
+
+    /* visits the blocks changed since the last clear_dirty like foreach_block does, i.e.
+     * fn(blk) for a full block and fn(blk, n) for the partial last one */
+    template <class Fn>
+    void foreach_dirty_block(Fn &&fn) const noexcept requires TrackChanges {
+        const std::size_t nblks = (std::size_t)m_densize >> DenseBlock::N;
+        const std::size_t nrest = m_densize - (nblks << DenseBlock::N);
+        for (std::size_t w = 0; w != m_dirty.size(); w++) {
+            for (std::uint64_t bits = m_dirty[w]; bits; bits &= bits - 1) {
+                std::size_t blknr = (w << 6) + std::countr_zero(bits);
+                if (blknr < nblks) {
+                    fn(m_dense[blknr]);
+                } else if (blknr == nblks && nrest) {
+                    fn(m_dense[blknr], nrest);
+                }
+            }
+        }
+    }
+
+    void clear_dirty() noexcept requires TrackChanges {
+        std::fill(m_dirty.begin(), m_dirty.end(), 0);
+        m_clean_version = m_version;
+    }
+
     DenseBlock &block(std::size_t blknr) noexcept {
         return m_dense[blknr];
     }
@@ -318,8 +1353,372 @@ struct SparseVec {
     }
 
     [[nodiscard]] Id max_id() const noexcept {
-        return m_spsize;
+        return m_index.max_id();
+    }
+};
+
+/* SparseVec with one dense column per component: every column is kept in its own blocks
+ * of 1 << DenseBits in the same dense order, so a loop over a few components streams only
+ * those columns; column_block<I> is 64-byte aligned and can be handed to consimd kernels.
+ * the block sizes come before the components, SparseVecSoA<Id, Ts...> takes the defaults;
+ * Alloc is rebound to every block type */
+template <class Id, class DenseId, class Alloc, std::size_t SparseBits, std::size_t DenseBits, class ...Ts>
+struct BasicSparseVecSoA {
+    using Index = SparseIndex<Id, DenseId, typename std::allocator_traits<Alloc>::template rebind_alloc<DenseId>, SparseBits>;
+    using allocator_type = Alloc;
+    using id_type = Id;
+    using Generation = typename Index::Generation;
+    using Handle = typename Index::Handle;
+
+    static constexpr Id npos = Index::npos;
+
+    template <std::size_t I>
+    using column_type = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+    template <class T>
+    struct alignas(64) ColumnBlock {
+        static const std::size_t N = DenseBits;
+        UninitArray<T, (1 << N)> vals;
+        ColumnBlock() noexcept {}
+    };
+
+    struct IdBlock {
+        static const std::size_t N = DenseBits;
+        Id inds[1 << N];
+    };
+
+    template <class T>
+    using Column = BlockVector<ColumnBlock<T>, Alloc>;
+
+    Index m_index;
+    BlockVector<IdBlock, Alloc> m_ids;
+    std::tuple<Column<Ts>...> m_columns;
+    DenseId m_densize;
+
+    BasicSparseVecSoA() noexcept : m_densize(0) {}
+
+    explicit BasicSparseVecSoA(Alloc const &alloc) noexcept
+    : m_index(alloc)
+    , m_ids(alloc)
+    , m_columns(Column<Ts>(alloc)...)
+    , m_densize(0)
+    {}
+
+    allocator_type get_allocator() const noexcept {
+        return allocator_type(m_ids.get_allocator());
+    }
+
+    BasicSparseVecSoA(BasicSparseVecSoA &&that) noexcept
+    : m_index(std::move(that.m_index))
+    , m_ids(std::move(that.m_ids))
+    , m_columns(std::move(that.m_columns))
+    , m_densize(std::exchange(that.m_densize, 0))
+    {}
+
+    BasicSparseVecSoA &operator=(BasicSparseVecSoA &&that) noexcept {
+        if (this != &that) {
+            _dense_destroy_all();
+            m_index = std::move(that.m_index);
+            m_ids = std::move(that.m_ids);
+            m_columns = std::move(that.m_columns);
+            m_densize = std::exchange(that.m_densize, 0);
+        }
+        return *this;
+    }
+
+    BasicSparseVecSoA(BasicSparseVecSoA const &that)
+    : m_index(that.m_index)
+    , m_ids(that.get_allocator())
+    , m_columns(Column<Ts>(that.get_allocator())...)
+    , m_densize(0)
+    {
+        for (DenseId did = 0; did != that.m_densize; did++) {
+            _dense_grow();
+            std::size_t blknr = (std::size_t)did >> DenseBits;
+            std::size_t blkoff = (std::size_t)did & ((1 << DenseBits) - 1);
+            m_ids[blknr].inds[blkoff] = that.m_ids[blknr].inds[blkoff];
+            [&] <std::size_t ...Is> (std::index_sequence<Is...>) {
+                (std::get<Is>(m_columns)[blknr].vals.construct_at(blkoff, std::get<Is>(that.m_columns)[blknr].vals[blkoff]), ...);
+            }(std::index_sequence_for<Ts...>{});
+            ++m_densize;
+        }
+    }
+
+    BasicSparseVecSoA &operator=(BasicSparseVecSoA const &that) {
+        if (this != &that) {
+            BasicSparseVecSoA copy(that);
+            swap(copy);
+        }
+        return *this;
+    }
+
+    ~BasicSparseVecSoA() noexcept {
+        _dense_destroy_all();
+    }
+
+    void swap(BasicSparseVecSoA &that) noexcept {
+        if (this != &that) {
+            m_index.swap(that.m_index);
+            m_ids.swap(that.m_ids);
+            [&] <std::size_t ...Is> (std::index_sequence<Is...>) {
+                (std::get<Is>(m_columns).swap(std::get<Is>(that.m_columns)), ...);
+            }(std::index_sequence_for<Ts...>{});
+            std::swap(m_densize, that.m_densize);
+        }
+    }
+
+    /* makes sure the block for dense id m_densize exists in every column */
+    void _dense_grow() {
+        std::size_t blknr = (std::size_t)m_densize >> DenseBits;
+        if (m_ids.size() <= blknr) {
+            m_ids.resize(blknr + 1);
+            std::apply([&] (auto &...cols) {
+                (cols.resize(blknr + 1), ...);
+            }, m_columns);
+        }
+    }
+
+    void _dense_push_back(Id id, Ts ...vals) noexcept {
+        _dense_grow();
+        std::size_t blknr = (std::size_t)m_densize >> DenseBits;
+        std::size_t blkoff = (std::size_t)m_densize & ((1 << DenseBits) - 1);
+        m_ids[blknr].inds[blkoff] = id;
+        [&] <std::size_t ...Is> (std::index_sequence<Is...>) {
+            (std::get<Is>(m_columns)[blknr].vals.construct_at(blkoff, std::move(vals)), ...);
+        }(std::index_sequence_for<Ts...>{});
+        ++m_densize;
+    }
+
+    void _dense_pop_back() noexcept {
+        --m_densize;
+        std::size_t bblknr = (std::size_t)m_densize >> DenseBits;
+        std::size_t bblkoff = (std::size_t)m_densize & ((1 << DenseBits) - 1);
+        std::apply([&] (auto &...cols) {
+            (cols[bblknr].vals.destroy_at(bblkoff), ...);
+        }, m_columns);
+    }
+
+    /* moves the last element into did in every column, returns the moved id */
+    Id _dense_swap_erase_back(DenseId did) noexcept {
+        std::size_t blknr = (std::size_t)did >> DenseBits;
+        std::size_t blkoff = (std::size_t)did & ((1 << DenseBits) - 1);
+        --m_densize;
+        std::size_t bblknr = (std::size_t)m_densize >> DenseBits;
+        std::size_t bblkoff = (std::size_t)m_densize & ((1 << DenseBits) - 1);
+        std::apply([&] (auto &...cols) {
+            ((cols[blknr].vals.destroy_at(blkoff),
+              cols[blknr].vals.construct_at(blkoff, std::move(cols[bblknr].vals[bblkoff])),
+              cols[bblknr].vals.destroy_at(bblkoff)), ...);
+        }, m_columns);
+        Id indb = m_ids[bblknr].inds[bblkoff];
+        m_ids[blknr].inds[blkoff] = indb;
+        return indb;
+    }
+
+    void _dense_destroy_all() noexcept {
+        if constexpr (!(std::is_trivially_destructible_v<Ts> && ...)) {
+            foreach([] (Id, Ts &...vals) {
+                (std::destroy_at(std::addressof(vals)), ...);
+            });
+        }
+    }
+
+    Id _dense_id_at(DenseId did) const noexcept {
+        return m_ids[(std::size_t)did >> DenseBits].inds[(std::size_t)did & ((1 << DenseBits) - 1)];
+    }
+
+    template <std::size_t I>
+    column_type<I> &_dense_at(DenseId did) noexcept {
+        return std::get<I>(m_columns)[(std::size_t)did >> DenseBits].vals[(std::size_t)did & ((1 << DenseBits) - 1)];
+    }
+
+    template <std::size_t I>
+    column_type<I> const &_dense_at(DenseId did) const noexcept {
+        return std::get<I>(m_columns)[(std::size_t)did >> DenseBits].vals[(std::size_t)did & ((1 << DenseBits) - 1)];
+    }
+
+    /* ids may be recycled from erased elements, use insert for a stale-safe handle */
+    Id push_back(Ts ...vals) noexcept {
+        return insert(std::move(vals)...).id;
+    }
+
+    Handle insert(Ts ...vals) noexcept {
+        Id id = m_index.alloc_id();
+        Generation gen = m_index.emplace(id, m_densize);
+        _dense_push_back(id, std::move(vals)...);
+        return {id, gen};
+    }
+
+    /* inserts under a caller-chosen id; fails and returns the existing handle if id is
+     * taken, or {npos, 0} for id == npos */
+    std::pair<Handle, bool> insert_at(Id id, Ts ...vals) noexcept {
+        if (id == npos) {
+            return {{npos, 0}, false};
+        }
+        DenseId did;
+        if (m_index.read(id, did)) {
+            return {handle_of(id), false};
+        }
+        m_index.claim_id(id);
+        Generation gen = m_index.emplace(id, m_densize);
+        _dense_push_back(id, std::move(vals)...);
+        return {{id, gen}, true};
+    }
+
+    [[nodiscard]] Handle handle_of(Id id) const noexcept {
+        return m_index.handle_of(id);
+    }
+
+    template <std::size_t I>
+    [[nodiscard]] column_type<I> *at(Id id) noexcept {
+        DenseId did;
+        if (!m_index.read(id, did)) {
+            return nullptr;
+        }
+        return &_dense_at<I>(did);
+    }
+
+    template <std::size_t I>
+    [[nodiscard]] column_type<I> const *at(Id id) const noexcept {
+        DenseId did;
+        if (!m_index.read(id, did)) {
+            return nullptr;
+        }
+        return &_dense_at<I>(did);
+    }
+
+    template <std::size_t I>
+    [[nodiscard]] column_type<I> *at(Handle h) noexcept {
+        DenseId did;
+        if (!m_index.read(h, did)) {
+            return nullptr;
+        }
+        return &_dense_at<I>(did);
+    }
+
+    template <std::size_t I>
+    [[nodiscard]] column_type<I> const *at(Handle h) const noexcept {
+        DenseId did;
+        if (!m_index.read(h, did)) {
+            return nullptr;
+        }
+        return &_dense_at<I>(did);
+    }
+
+    [[nodiscard]] bool contains(Id id) const noexcept {
+        DenseId did;
+        return m_index.read(id, did);
+    }
+
+    [[nodiscard]] bool contains(Handle h) const noexcept {
+        DenseId did;
+        return m_index.read(h, did);
+    }
+
+    /* erases the last element in dense order */
+    void pop_back() noexcept {
+        DenseId did;
+        m_index.erase(_dense_id_at(m_densize - 1), did);
+        _dense_pop_back();
+    }
+
+    bool erase(Id id) noexcept {
+        DenseId did;
+        if (!m_index.erase(id, did)) {
+            return false;
+        }
+        if (did + 1 == m_densize) {
+            _dense_pop_back();
+        } else {
+            Id indb = _dense_swap_erase_back(did);
+            m_index.update(indb, did);
+        }
+        return true;
+    }
+
+    bool erase(Handle h) noexcept {
+        if (!contains(h)) {
+            return false;
+        }
+        return erase(h.id);
+    }
+
+    void clear() noexcept {
+        while (m_densize != 0) {
+            pop_back();
+        }
+    }
+
+    /* fn(id, components...) in dense order */
+    template <class Fn>
+    void foreach(Fn &&fn) noexcept {
+        for (std::size_t blknr = 0; blknr * (1 << DenseBits) < m_densize; blknr++) {
+            std::size_t n = std::min<std::size_t>(m_densize - blknr * (1 << DenseBits), 1 << DenseBits);
+            Id const *inds = m_ids[blknr].inds;
+            std::apply([&] (auto &...cols) {
+                for (std::size_t blkoff = 0; blkoff != n; blkoff++) {
+                    fn(inds[blkoff], cols[blknr].vals[blkoff]...);
+                }
+            }, m_columns);
+        }
+    }
+
+    /* fn(n, column_block<Is>(blknr)...) for every block, n is short for the last one */
+    template <std::size_t ...Is, class Fn>
+    void foreach_columns(Fn &&fn) noexcept {
+        for (std::size_t blknr = 0; blknr * (1 << DenseBits) < m_densize; blknr++) {
+            std::size_t n = std::min<std::size_t>(m_densize - blknr * (1 << DenseBits), 1 << DenseBits);
+            fn(n, column_block<Is>(blknr)...);
+        }
+    }
+
+    /* foreach_columns with blocks spread over pool, chunk blocks per scheduling unit */
+    template <std::size_t ...Is, class Pool, class Fn>
+    void parallel_foreach_columns(Pool &pool, Fn &&fn, std::size_t chunk = 1) noexcept {
+        const std::size_t n = m_densize;
+        pool.parallel_for((n + (1 << DenseBits) - 1) >> DenseBits, chunk, [&] (std::size_t begin, std::size_t end) {
+            for (std::size_t blknr = begin; blknr != end; blknr++) {
+                fn(std::min<std::size_t>(n - (blknr << DenseBits), 1 << DenseBits), column_block<Is>(blknr)...);
+            }
+        });
+    }
+
+    template <std::size_t I>
+    column_type<I> *column_block(std::size_t blknr) noexcept {
+        return std::get<I>(m_columns)[blknr].vals.inner;
+    }
+
+    template <std::size_t I>
+    column_type<I> const *column_block(std::size_t blknr) const noexcept {
+        return std::get<I>(m_columns)[blknr].vals.inner;
+    }
+
+    Id const *id_block(std::size_t blknr) const noexcept {
+        return m_ids[blknr].inds;
+    }
+
+    static constexpr std::size_t block_size() noexcept {
+        return DenseBits;
+    }
+
+    std::size_t block_count() const noexcept {
+        return (std::size_t)m_densize >> DenseBits;
+    }
+
+    std::size_t last_block_size() const noexcept {
+        return m_densize - (block_count() << DenseBits);
+    }
+
+    [[nodiscard]] DenseId size() const noexcept {
+        return m_densize;
+    }
+
+    [[nodiscard]] Id max_id() const noexcept {
+        return m_index.max_id();
     }
 };
 
+template <class Id, class ...Ts>
+using SparseVecSoA = BasicSparseVecSoA<Id, std::size_t, std::allocator<Id>, 8, 8, Ts...>;
+
 }
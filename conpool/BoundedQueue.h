@@ -0,0 +1,100 @@
+#pragma once
+
+#include <type_traits>
+#include <atomic>
+#include <optional>
+#include <memory>
+#include <thread>
+#include <cstddef>
+#include <cstdint>
+
+namespace conpool {
+
+/* multi-producer multi-consumer FIFO over a fixed ring of Capacity cells (D. Vyukov's
+ * bounded queue): every cell carries a sequence number that tells producers and
+ * consumers whose turn it is, so there are no nodes to allocate and no ABA. push waits
+ * for a free cell when the ring is full; try_push does not */
+template <class T, std::size_t Capacity = 256>
+struct BoundedQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of 2");
+    static_assert(std::is_nothrow_move_constructible_v<T>);
+
+    struct Cell {
+        std::atomic<std::size_t> seq;
+        union {
+            T value;
+        };
+        Cell() noexcept {}
+        ~Cell() {}
+    };
+
+    Cell m_cells[Capacity];
+    alignas(64) std::atomic<std::size_t> m_enqueue{0};
+    alignas(64) std::atomic<std::size_t> m_dequeue{0};
+
+    BoundedQueue() noexcept {
+        for (std::size_t i = 0; i < Capacity; i++) {
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(BoundedQueue const &) = delete;
+    BoundedQueue &operator=(BoundedQueue const &) = delete;
+
+    ~BoundedQueue() noexcept {
+        while (try_pop()) {
+        }
+    }
+
+    bool try_push(T &&value) noexcept {
+        std::size_t pos = m_enqueue.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &m_cells[pos & (Capacity - 1)];
+            std::size_t seq = cell->seq.load(std::memory_order_acquire);
+            auto dif = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (dif == 0) {
+                if (m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = m_enqueue.load(std::memory_order_relaxed);
+            }
+        }
+        std::construct_at(std::addressof(cell->value), std::move(value));
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    void push(auto &&...args) requires (std::constructible_from<T, decltype(args)...>) {
+        T value(std::forward<decltype(args)>(args)...);
+        while (!try_push(std::move(value))) {
+            std::this_thread::yield();
+        }
+    }
+
+    std::optional<T> try_pop() noexcept {
+        std::size_t pos = m_dequeue.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &m_cells[pos & (Capacity - 1)];
+            std::size_t seq = cell->seq.load(std::memory_order_acquire);
+            auto dif = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+            if (dif == 0) {
+                if (m_dequeue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0) {
+                return std::nullopt;
+            } else {
+                pos = m_dequeue.load(std::memory_order_relaxed);
+            }
+        }
+        std::optional<T> result(std::move(cell->value));
+        std::destroy_at(std::addressof(cell->value));
+        cell->seq.store(pos + Capacity, std::memory_order_release);
+        return result;
+    }
+};
+
+}
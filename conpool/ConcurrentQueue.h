@@ -7,7 +7,7 @@
 
 namespace conpool {
 
-template <class T>
+template <class T, class Alloc = std::allocator<T>>
 struct ConcurrentQueue {
     struct Node {
         union {
@@ -17,17 +17,38 @@ struct ConcurrentQueue {
         Node() {}
         ~Node() {}
     };
+    using NodeAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Node>;
+    using NodeAllocTrait = std::allocator_traits<NodeAlloc>;
+
     std::atomic<Node *> head{nullptr};
+    [[no_unique_address]] NodeAlloc m_alloc;
+
+    ConcurrentQueue() = default;
+
+    explicit ConcurrentQueue(Alloc const &alloc) noexcept
+    : m_alloc(alloc) {}
+
+    Node *_new_node() {
+        Node *node = NodeAllocTrait::allocate(m_alloc, 1);
+        std::construct_at(node);
+        return node;
+    }
+
+    void _delete_node(Node *node) noexcept {
+        std::destroy_at(node);
+        NodeAllocTrait::deallocate(m_alloc, node, 1);
+    }
 
     void push(auto &&...args) requires (std::constructible_from<T, decltype(args)...>) {
         Node *hptr, *node;
-        node = new Node;
+        node = _new_node();
         struct exception_guard {
+            ConcurrentQueue *self;
             Node *ptr;
             ~exception_guard() noexcept {
-                delete ptr;
+                if (ptr) self->_delete_node(ptr);
             }
-        } exguard{node};
+        } exguard{this, node};
         std::construct_at(std::addressof(node->value), std::forward<decltype(args)>(args)...);
         exguard.ptr = nullptr;
         hptr = head.load(std::memory_order_acquire);
@@ -46,7 +67,7 @@ struct ConcurrentQueue {
         } while (!head.compare_exchange_weak(hptr, next, std::memory_order_release, std::memory_order_acquire));
         auto result = std::optional<T>(std::move(hptr->value));
         std::destroy_at(std::addressof(hptr->value));
-        delete hptr;
+        _delete_node(hptr);
         return result;
     }
 };
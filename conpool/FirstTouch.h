@@ -0,0 +1,77 @@
+#pragma once
+
+#include <span>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include "ThreadPool.h"
+#include "../constl/noinit_allocator.h"
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+namespace conpool {
+
+inline std::size_t page_size() noexcept {
+#if defined(__linux__)
+    static const std::size_t size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    return size;
+#else
+    return 4096;
+#endif
+}
+
+/* fault in the pages of a freshly allocated, not yet initialized buffer from the
+ * workers that will later process them, using the same static_partition as
+ * parallel_static; a zero byte is stored into each page, so do not call this on
+ * data you want to keep */
+template <class T, class Pool = ThreadPool>
+void parallel_first_touch(std::span<T> buf, Pool &pool = Pool::default_pool()) {
+    static_assert(std::is_trivially_default_constructible_v<T>, "first touch would clobber constructed objects");
+    if (buf.empty()) return;
+    const std::size_t page = page_size();
+    pool.parallel_static(buf.size(), [&buf, page] (std::size_t, std::size_t begin, std::size_t end) {
+        auto first = reinterpret_cast<std::uintptr_t>(buf.data() + begin);
+        auto last = reinterpret_cast<std::uintptr_t>(buf.data() + end);
+        /* a page straddling two slices belongs to the slice that holds its first byte */
+        std::uintptr_t p = begin == 0 ? first : (first + page - 1) & ~(page - 1);
+        for (; p < last; p = (p & ~(page - 1)) + page) {
+            *reinterpret_cast<volatile unsigned char *>(p) = 0;
+        }
+    });
+}
+
+/* NoinitAllocator that pre-faults big allocations in parallel */
+template <class T, class Pool = ThreadPool>
+struct FirstTouchAllocator : constl::NoinitAllocator<T> {
+    static constexpr std::size_t first_touch_threshold = std::size_t(1) << 20;
+
+    using value_type = T;
+    using is_always_equal = std::true_type;
+
+    FirstTouchAllocator() = default;
+
+    template <class U>
+    constexpr FirstTouchAllocator(FirstTouchAllocator<U, Pool> const &) noexcept {}
+
+    T *allocate(std::size_t n) {
+        T *p = this->m_base.allocate(n);
+        if constexpr (std::is_trivially_default_constructible_v<T>) {
+            if (n * sizeof(T) >= first_touch_threshold) {
+                parallel_first_touch(std::span<T>(p, n), Pool::default_pool());
+            }
+        }
+        return p;
+    }
+
+    void deallocate(T *p, std::size_t n) noexcept {
+        this->m_base.deallocate(p, n);
+    }
+
+    template <class U>
+    constexpr bool operator==(FirstTouchAllocator<U, Pool> const &) const noexcept {
+        return true;
+    }
+};
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace conpool {
+
+/* below this a single stable_sort beats fanning out */
+inline constexpr std::size_t parallel_sort_threshold = std::size_t(1) << 14;
+
+/* stable sort of [first, last) on pool: every worker stable_sorts its static slice, then
+ * neighbouring runs are inplace_merged pairwise in parallel, halving the run count per
+ * round; both steps keep equal elements in input order */
+template <class Pool, class It, class Comp = std::less<>>
+void parallel_sort(Pool &pool, It first, It last, Comp comp = {}) {
+    const std::size_t n = last - first;
+    const std::size_t nparts = pool.num_workers();
+    if (n < parallel_sort_threshold || nparts <= 1) {
+        std::stable_sort(first, last, comp);
+        return;
+    }
+    std::vector<std::size_t> cuts(nparts + 1);
+    for (std::size_t part = 0; part != nparts; part++) {
+        cuts[part] = Pool::static_partition(n, nparts, part).first;
+    }
+    cuts[nparts] = n;
+    pool.parallel_static(n, [&] (std::size_t, std::size_t begin, std::size_t end) {
+        std::stable_sort(first + begin, first + end, comp);
+    });
+    for (std::size_t width = 1; width < nparts; width *= 2) {
+        pool.parallel_for((nparts + 2 * width - 1) / (2 * width), 1, [&] (std::size_t begin, std::size_t end) {
+            for (std::size_t k = begin; k != end; k++) {
+                std::size_t lo = k * 2 * width;
+                std::size_t mid = std::min(lo + width, nparts);
+                std::size_t hi = std::min(lo + 2 * width, nparts);
+                if (mid != hi) {
+                    std::inplace_merge(first + cuts[lo], first + cuts[mid], first + cuts[hi], comp);
+                }
+            }
+        });
+    }
+}
+
+}
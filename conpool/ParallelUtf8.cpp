@@ -0,0 +1,94 @@
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "ParallelUtf8.h"
+#include "ThreadPool.h"
+#include "../constl/utf8.h"
+#include "../consimd/strategy.h"
+#include "../contest/test.h"
+
+namespace conpool {
+
+TEST_BEGIN()
+
+/* ncps code points of mixed width, so that cuts land inside sequences */
+static std::u8string make_parallel_text(size_t ncps, unsigned seed) {
+    static const char32_t samples[] = {
+        0xe9, 0x3b1, 0x7ff, 0x800, 0x4e2d, 0xffff, 0x10000, 0x1f600, 0x10ffff,
+    };
+    std::u8string s;
+    for (size_t k = 0; k < ncps; k++) {
+        seed = seed * 1103515245 + 12345;
+        unsigned r = seed >> 8;
+        char8_t buf[4];
+        char32_t cp = r % 2 ? char32_t('a' + r % 26) : samples[r / 2 % std::size(samples)];
+        s.append(buf, constl::encode_utf8(buf, cp));
+    }
+    return s;
+}
+
+TEST_TYPES(ParallelUtf8Strategies
+           , consimd::strategy::AVX
+           , consimd::strategy::Scalar
+           );
+
+TEST_T(ParallelUtf8Decode, ParallelUtf8Strategies) {
+    ThreadPool pool(4);
+    std::u8string in = make_parallel_text(700000, 1); /* over parallel_utf8_threshold */
+    EXPECT_GT(in.size(), _parallel_utf8_details::parallel_utf8_threshold);
+
+    std::u32string expect, got;
+    EXPECT_EQ(constl::decode_utf8_string(expect, in, TestType{}), 0);
+    EXPECT_EQ(decode_utf8_parallel(got, in, TestType{}, pool), 0);
+    EXPECT_EQ(got == expect, true);
+
+    /* a sequence cut by the end is left over, as in decode_utf8_string */
+    in += u8"\xf0\x9f\x98";
+    EXPECT_EQ(decode_utf8_parallel(got, in, TestType{}, pool), 3);
+    EXPECT_EQ(got == expect, true);
+    in.resize(in.size() - 3);
+
+    /* malformed bytes in one chunk fall back to the lenient decode of the whole input */
+    in[in.size() / 3] = u8'\x80';
+    in.insert(in.size() / 2, u8"\xe2\x82" "A");
+    EXPECT_EQ(constl::decode_utf8_string(expect, in, TestType{}), 0);
+    EXPECT_EQ(decode_utf8_parallel(got, in, TestType{}, pool), 0);
+    EXPECT_EQ(got == expect, true);
+
+    /* below the threshold it decodes on the calling thread */
+    std::u8string small = make_parallel_text(1000, 2);
+    EXPECT_EQ(constl::decode_utf8_string(expect, small, TestType{}), 0);
+    EXPECT_EQ(decode_utf8_parallel(got, small, TestType{}, pool), 0);
+    EXPECT_EQ(got == expect, true);
+}
+
+TEST_T(ParallelUtf8Index, ParallelUtf8Strategies) {
+    ThreadPool pool(4);
+    for (size_t ncps: {0, 1, 3, 63, 64, 65, 1000, 100000}) {
+        std::u8string in = make_parallel_text(ncps, (unsigned)ncps);
+        std::vector<size_t> offsets;
+        for (size_t i = 0; i < in.size(); i += constl::decode_utf8_len(in[i])) {
+            offsets.push_back(i);
+        }
+        offsets.push_back(in.size());
+
+        Utf8Index<64, TestType> serial(in);
+        Utf8Index<64, TestType> parallel(in, pool);
+        EXPECT_EQ(serial.size(), ncps);
+        EXPECT_EQ(parallel.size(), ncps);
+        bool ok = true;
+        for (size_t cp = 0; cp <= ncps; cp += cp < 200 ? 1 : 37) {
+            ok &= serial.byte_offset(in, cp) == offsets[cp];
+            ok &= parallel.byte_offset(in, cp) == offsets[cp];
+            if (cp < ncps) {
+                ok &= parallel.at(in, cp) == constl::decode_utf8(in.data() + offsets[cp]).second;
+            }
+        }
+        EXPECT_EQ(ok, true);
+        EXPECT_EQ(parallel.byte_offset(in, ncps), in.size());
+    }
+}
+
+TEST_END()
+
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <atomic>
+#include "ThreadPool.h"
+#include "../constl/utf8.h"
+#include "../consimd/utf8.h"
+#include "../consimd/strategy.h"
+
+namespace conpool {
+
+namespace _parallel_utf8_details {
+
+/* below this a single thread decodes faster than we can fan out */
+inline constexpr std::size_t parallel_utf8_threshold = std::size_t(1) << 20;
+
+/* nparts + 1 cut points into in, each moved forward onto the start of a sequence;
+ * a lead byte is at most 3 continuation bytes away, unless the input is malformed */
+inline std::vector<std::size_t> utf8_split(std::u8string_view in, std::size_t nparts) {
+    std::vector<std::size_t> cuts(nparts + 1);
+    for (std::size_t i = 1; i < nparts; i++) {
+        std::size_t cut = std::max(cuts[i - 1], in.size() * i / nparts);
+        for (std::size_t k = 0; k < 3 && cut < in.size() && (in[cut] & 0b1100'0000) == 0b1000'0000; k++) {
+            ++cut;
+        }
+        cuts[i] = cut;
+    }
+    cuts[nparts] = in.size();
+    return cuts;
+}
+
+}
+
+/* same contract as constl::decode_utf8_string; chunks cut on sequence starts are
+ * validated and counted in parallel, the counts prefix-summed into output offsets,
+ * then every chunk decodes into its own slice of out */
+template <class Strategy = consimd::strategy::Scalar, class Pool = ThreadPool>
+std::size_t decode_utf8_parallel(std::u32string &out, std::u8string_view in, Strategy = {}, Pool &pool = Pool::default_pool()) {
+    using namespace _parallel_utf8_details;
+    if (in.size() < parallel_utf8_threshold) {
+        return constl::decode_utf8_string(out, in, Strategy{});
+    }
+    std::size_t rest = constl::_utf8_details::_utf8_incomplete_tail(in);
+    in.remove_suffix(rest);
+    std::size_t nparts = pool.num_workers();
+    std::vector<std::size_t> cuts = utf8_split(in, nparts);
+    std::vector<std::size_t> offsets(nparts + 1);
+    std::atomic<bool> invalid{false};
+    pool.parallel_static(nparts, [&] (std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t p = begin; p < end; p++) {
+            std::size_t count = consimd::utf8_validate<Strategy>()(in.data() + cuts[p], cuts[p + 1] - cuts[p]);
+            if (count == consimd::utf8_invalid) [[unlikely]] {
+                invalid.store(true, std::memory_order_relaxed);
+                count = 0;
+            }
+            offsets[p + 1] = count;
+        }
+    });
+    if (invalid.load(std::memory_order_relaxed)) [[unlikely]] {
+        constl::_utf8_details::_decode_utf8_string_lenient(out, in);
+        return rest;
+    }
+    for (std::size_t p = 0; p < nparts; p++) {
+        offsets[p + 1] += offsets[p];
+    }
+    out.resize(offsets[nparts]);
+    pool.parallel_static(nparts, [&] (std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t p = begin; p < end; p++) {
+            consimd::utf8_decode<Strategy>()(in.data() + cuts[p], out.data() + offsets[p], cuts[p + 1] - cuts[p]);
+        }
+    });
+    return rest;
+}
+
+/* byte offset of every stride-th code point, so locating the n-th code point scans at
+ * most stride - 1 sequences; code points are counted as non-continuation bytes, which
+ * is exact for well-formed input. the index does not own the text */
+template <std::size_t Stride = 64, class Strategy = consimd::strategy::Scalar>
+struct Utf8Index {
+    static constexpr std::size_t stride = Stride;
+
+private:
+    std::vector<std::size_t> m_samples;
+    std::size_t m_count = 0;
+
+    static bool _is_lead(char8_t c) noexcept {
+        return (c & 0b1100'0000) != 0b1000'0000;
+    }
+
+    /* samples for the lead bytes of in[begin, end), whose first one is code point first */
+    void _sample(std::u8string_view in, std::size_t begin, std::size_t end, std::size_t first) {
+        std::size_t next = (first + Stride - 1) / Stride * Stride;
+        for (std::size_t i = begin, cp = first; i < end; i++) {
+            if (_is_lead(in[i])) {
+                if (cp == next) {
+                    m_samples[cp / Stride] = i;
+                    next += Stride;
+                }
+                ++cp;
+            }
+        }
+    }
+
+public:
+    Utf8Index() = default;
+
+    explicit Utf8Index(std::u8string_view in) {
+        m_count = consimd::utf8_count<Strategy>()(in.data(), in.size());
+        m_samples.resize((m_count + Stride - 1) / Stride);
+        _sample(in, 0, in.size(), 0);
+    }
+
+    template <class Pool>
+    Utf8Index(std::u8string_view in, Pool &pool) {
+        std::size_t nparts = pool.num_workers();
+        std::vector<std::size_t> firsts(nparts + 1);
+        /* lead bytes are additive, so any byte partition will do */
+        pool.parallel_static(in.size(), [&] (std::size_t part, std::size_t begin, std::size_t end) {
+            firsts[part + 1] = consimd::utf8_count<Strategy>()(in.data() + begin, end - begin);
+        });
+        for (std::size_t p = 0; p < nparts; p++) {
+            firsts[p + 1] += firsts[p];
+        }
+        m_count = firsts[nparts];
+        m_samples.resize((m_count + Stride - 1) / Stride);
+        pool.parallel_static(in.size(), [&] (std::size_t part, std::size_t begin, std::size_t end) {
+            _sample(in, begin, end, firsts[part]);
+        });
+    }
+
+    std::size_t size() const noexcept {
+        return m_count;
+    }
+
+    /* in must be the text the index was built from; cp == size() maps to in.size() */
+    std::size_t byte_offset(std::u8string_view in, std::size_t cp) const noexcept {
+        if (cp >= m_count) {
+            return in.size();
+        }
+        std::size_t i = m_samples[cp / Stride];
+        for (std::size_t skip = cp % Stride; skip; --skip) {
+            do ++i; while (!_is_lead(in[i]));
+        }
+        return i;
+    }
+
+    char32_t at(std::u8string_view in, std::size_t cp) const noexcept {
+        return constl::decode_utf8(in.data() + byte_offset(in, cp)).second;
+    }
+};
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+namespace conpool {
+
+/* stable LSD radix sort of keys[0, n) carrying vals along, one byte per pass; each pass
+ * histograms the workers' static slices in parallel, scans the counts in (digit, worker)
+ * order and scatters every slice from its own offsets, which keeps equal keys in input
+ * order. passes where all keys share the digit are skipped */
+template <class Pool, class Key, class Val>
+void radix_sort_pairs(Pool &pool, Key *keys, Val *vals, std::size_t n) {
+    static_assert(std::is_unsigned_v<Key>, "radix sort needs an unsigned key");
+    constexpr std::size_t R = 256;
+    const std::size_t nparts = pool.num_workers();
+    std::vector<Key> tmp_keys(n);
+    std::vector<Val> tmp_vals(n);
+    std::vector<std::size_t> counts(nparts * R);
+    Key *src_k = keys, *dst_k = tmp_keys.data();
+    Val *src_v = vals, *dst_v = tmp_vals.data();
+    for (std::size_t shift = 0; shift < sizeof(Key) * 8; shift += 8) {
+        std::fill(counts.begin(), counts.end(), 0);
+        pool.parallel_static(n, [&] (std::size_t part, std::size_t begin, std::size_t end) {
+            std::size_t *cnt = counts.data() + part * R;
+            for (std::size_t i = begin; i != end; i++) {
+                ++cnt[(src_k[i] >> shift) & (R - 1)];
+            }
+        });
+        std::size_t sum = 0, nonempty = 0;
+        for (std::size_t d = 0; d != R; d++) {
+            std::size_t total = 0;
+            for (std::size_t part = 0; part != nparts; part++) {
+                std::size_t c = counts[part * R + d];
+                counts[part * R + d] = sum + total;
+                total += c;
+            }
+            sum += total;
+            nonempty += total != 0;
+        }
+        if (nonempty <= 1) {
+            continue;
+        }
+        pool.parallel_static(n, [&] (std::size_t part, std::size_t begin, std::size_t end) {
+            std::size_t *off = counts.data() + part * R;
+            for (std::size_t i = begin; i != end; i++) {
+                std::size_t o = off[(src_k[i] >> shift) & (R - 1)]++;
+                dst_k[o] = src_k[i];
+                dst_v[o] = std::move(src_v[i]);
+            }
+        });
+        std::swap(src_k, dst_k);
+        std::swap(src_v, dst_v);
+    }
+    if (src_k != keys) {
+        std::copy_n(src_k, n, keys);
+        std::move(src_v, src_v + n, vals);
+    }
+}
+
+}
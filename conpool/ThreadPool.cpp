@@ -0,0 +1,130 @@
+#include <new>
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <cstdlib>
+#include <cstddef>
+#include "ThreadPool.h"
+#include "BoundedQueue.h"
+#include "../contest/test.h"
+
+/* counts the allocations made while g_count_allocs is set, from any thread */
+static std::atomic<bool> g_count_allocs{false};
+static std::atomic<std::size_t> g_allocs{0};
+
+void *operator new(std::size_t n) {
+    if (g_count_allocs.load(std::memory_order_relaxed)) {
+        g_allocs.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void *p = std::malloc(n ? n : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+/* the nothrow pair too (std::stable_sort's temporary buffer), so nothing handed to free
+ * comes from another allocator */
+void *operator new(std::size_t n, std::nothrow_t const &) noexcept {
+    try {
+        return ::operator new(n);
+    } catch (std::bad_alloc const &) {
+        return nullptr;
+    }
+}
+
+void operator delete(void *p, std::nothrow_t const &) noexcept {
+    std::free(p);
+}
+
+namespace conpool {
+
+TEST_BEGIN()
+
+/* allocations made by a round of parallel_for and parallel_static on pool */
+template <class Pool>
+static std::size_t count_pool_allocs(Pool &pool) {
+    std::atomic<std::size_t> sum{0};
+    auto body = [&] {
+        for (int round = 0; round < 100; round++) {
+            pool.parallel_for(1000, 10, [&] (std::size_t begin, std::size_t end) {
+                sum.fetch_add(end - begin, std::memory_order_relaxed);
+            });
+            pool.parallel_static(1000, [&] (std::size_t, std::size_t begin, std::size_t end) {
+                sum.fetch_add(end - begin, std::memory_order_relaxed);
+            });
+        }
+    };
+    body(); /* warm up */
+    g_allocs.store(0);
+    g_count_allocs.store(true);
+    body();
+    g_count_allocs.store(false);
+    return sum.load() == 400000 ? g_allocs.load() : std::size_t(-1);
+}
+
+TEST(InplaceThreadPoolNoAlloc) {
+    InplaceThreadPool<64> pool(4);
+    EXPECT_EQ(count_pool_allocs(pool), 0);
+    /* the counter does see the node allocations of the default queue */
+    ThreadPool heap_pool(4);
+    EXPECT_GT(count_pool_allocs(heap_pool), 0);
+}
+
+TEST(BoundedQueueFifo) {
+    BoundedQueue<int, 4> q;
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(q.try_push(int(i)), true);
+    }
+    EXPECT_EQ(q.try_push(4), false);
+    for (int round = 0; round < 10; round++) {
+        EXPECT_EQ(*q.try_pop(), round);
+        EXPECT_EQ(q.try_push(round + 4), true);
+    }
+    for (int i = 10; i < 14; i++) {
+        EXPECT_EQ(*q.try_pop(), i);
+    }
+    EXPECT_EQ(q.try_pop().has_value(), false);
+}
+
+/* producers block on a ring much smaller than what passes through it, and every value
+ * comes out exactly once */
+TEST(BoundedQueueConcurrent) {
+    constexpr int nthreads = 4, per_thread = 20000;
+    BoundedQueue<int, 16> q;
+    std::vector<std::atomic<int>> seen(nthreads * per_thread);
+    std::atomic<int> npopped{0};
+    std::vector<std::jthread> threads;
+    for (int t = 0; t < nthreads; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < per_thread; i++) {
+                q.push(t * per_thread + i);
+            }
+        });
+        threads.emplace_back([&] {
+            while (npopped.load() < nthreads * per_thread) {
+                if (auto v = q.try_pop()) {
+                    seen[*v].fetch_add(1);
+                    npopped.fetch_add(1);
+                }
+            }
+        });
+    }
+    threads.clear();
+    bool once = true;
+    for (auto &s: seen) {
+        once &= s.load() == 1;
+    }
+    EXPECT_EQ(once, true);
+}
+
+TEST_END()
+
+}
@@ -10,8 +10,12 @@
 #include <type_traits>
 #include <thread>
 #include <latch>
+#include <atomic>
+#include <optional>
 #include "ConcurrentQueue.h"
+#include "BoundedQueue.h"
 #include "../constl/move_only_function.h"
+#include "../constl/inplace_function.h"
 #if defined(_WIN32)
 #include <windows.h>
 #elif defined(__linux__)
@@ -21,10 +25,15 @@
 
 namespace conpool {
 
-struct ThreadPool {
+template <class Task = move_only_function<void()>, class Queue = ConcurrentQueue<Task>>
+struct BasicThreadPool {
+    using task_type = Task;
+    using queue_type = Queue;
+
     struct ThreadData {
         std::jthread m_thread;
-        ConcurrentQueue<move_only_function<void()>> m_task_queue;
+        Queue m_task_queue;
+        Queue m_pinned_queue; /* run by this worker only, never stolen */
     };
 
     std::vector<ThreadData> m_threads;
@@ -48,23 +57,23 @@ struct ThreadPool {
         return true;
     }
 
-    ThreadPool() : ThreadPool(std::thread::hardware_concurrency()) {
+    BasicThreadPool() : BasicThreadPool(std::thread::hardware_concurrency()) {
         for (std::size_t i = 0; i < m_threads.size(); ++i) {
             set_thread_affinity(m_threads[i].m_thread.native_handle(), i);
         }
     }
 
-    explicit ThreadPool(std::size_t nthreads) : m_threads(std::max(nthreads, std::size_t(1))) {
+    explicit BasicThreadPool(std::size_t nthreads) : m_threads(std::max(nthreads, std::size_t(1))) {
         for (auto &thread_data: m_threads) {
             thread_data.m_thread = std::jthread(_thread_entry, this, &thread_data);
         }
     }
 
-    ThreadPool(ThreadPool &&) = delete;
-    ThreadPool &operator=(ThreadPool &&) = delete;
-    ThreadPool(ThreadPool const &) = delete;
-    ThreadPool &operator=(ThreadPool const &) = delete;
-    ~ThreadPool() noexcept {
+    BasicThreadPool(BasicThreadPool &&) = delete;
+    BasicThreadPool &operator=(BasicThreadPool &&) = delete;
+    BasicThreadPool(BasicThreadPool const &) = delete;
+    BasicThreadPool &operator=(BasicThreadPool const &) = delete;
+    ~BasicThreadPool() noexcept {
         request_stop();
     }
 
@@ -76,18 +85,17 @@ struct ThreadPool {
     }
 
     static inline thread_local struct {
-        ThreadPool *this_pool;
+        BasicThreadPool *this_pool;
         ThreadData *this_thread;
         std::vector<std::size_t> workers;
         std::mt19937 rand_gen;
     } m_tls{nullptr, nullptr};
 
-    static void _look_for_task(std::invocable auto is_stop, ThreadPool *this_pool, ThreadData *this_thread) {
-        {
-            auto &q = this_thread->m_task_queue;
+    static void _look_for_task(std::invocable auto is_stop, BasicThreadPool *this_pool, ThreadData *this_thread) {
+        for (auto *q: {&this_thread->m_pinned_queue, &this_thread->m_task_queue}) {
             while (true) {
                 if (is_stop()) return;
-                if (auto task = q.try_pop()) {
+                if (auto task = q->try_pop()) {
                     std::move(*task)();
                 } else {
                     break;
@@ -107,7 +115,7 @@ struct ThreadPool {
         }
     }
 
-    static void _thread_entry(std::stop_token stoken, ThreadPool *this_pool, ThreadData *this_thread) {
+    static void _thread_entry(std::stop_token stoken, BasicThreadPool *this_pool, ThreadData *this_thread) {
         m_tls.this_pool = this_pool;
         m_tls.this_thread = this_thread;
         m_tls.workers.resize(this_pool->m_threads.size());
@@ -139,6 +147,10 @@ struct ThreadPool {
                 m_latch.count_down();
             }), ...);
         }
+        _wait_helping(m_latch, this_pool, this_thread);
+    }
+
+    static void _wait_helping(std::latch &m_latch, BasicThreadPool *this_pool, ThreadData *this_thread) {
         bool ready = false;
         do {
             auto stoken = this_thread->m_thread.get_stop_token();
@@ -152,17 +164,87 @@ struct ThreadPool {
         } while (!ready);
     }
 
+    std::size_t num_workers() const noexcept {
+        return m_threads.size();
+    }
+
+    static std::pair<std::size_t, std::size_t> static_partition(std::size_t n, std::size_t nparts, std::size_t part) noexcept {
+        std::size_t q = n / nparts, r = n % nparts;
+        std::size_t begin = part * q + std::min(part, r);
+        return {begin, begin + q + (part < r)};
+    }
+
+    /* fn(worker, begin, end) for the worker-th slice of [0, n), each pinned to its own worker,
+     * which no other worker steals from; loops that partition the same way touch the same
+     * memory from the same thread */
+    void parallel_static(std::size_t n, std::invocable<std::size_t, std::size_t, std::size_t> auto &&fn) {
+        std::size_t nparts = m_threads.size();
+        std::latch m_latch{static_cast<std::ptrdiff_t>(nparts)};
+        for (std::size_t i = 0; i < nparts; i++) {
+            auto [begin, end] = static_partition(n, nparts, i);
+            m_threads[i].m_pinned_queue.push([&m_latch, &fn, i, begin = begin, end = end] {
+                if (begin != end) fn(i, begin, end);
+                m_latch.count_down();
+            });
+        }
+        if (m_tls.this_pool == this) {
+            _wait_helping(m_latch, this, m_tls.this_thread);
+        } else {
+            m_latch.wait();
+        }
+    }
+
+    /* fn(begin, end) over [0, n) in chunks of grain, handed out through a shared counter
+     * so uneven chunks balance across workers */
+    void parallel_for(std::size_t n, std::size_t grain, std::invocable<std::size_t, std::size_t> auto &&fn) {
+        grain = std::max(grain, std::size_t(1));
+        std::size_t nchunks = (n + grain - 1) / grain;
+        std::size_t nparts = std::min(m_threads.size(), nchunks);
+        if (nparts == 0) return;
+        std::atomic<std::size_t> next{0};
+        std::latch m_latch{static_cast<std::ptrdiff_t>(nparts)};
+        for (std::size_t i = 0; i < nparts; i++) {
+            m_threads[i].m_task_queue.push([&m_latch, &fn, &next, n, grain, nchunks] {
+                for (std::size_t c; (c = next.fetch_add(1, std::memory_order_relaxed)) < nchunks; ) {
+                    fn(c * grain, std::min(n, (c + 1) * grain));
+                }
+                m_latch.count_down();
+            });
+        }
+        if (m_tls.this_pool == this) {
+            _wait_helping(m_latch, this, m_tls.this_thread);
+        } else {
+            m_latch.wait();
+        }
+    }
+
+    /* combine(...combine(combine(init, map(chunk0)), map(chunk1))...) with chunks as in
+     * parallel_for; partials are folded in chunk order, so the result does not depend on
+     * scheduling even for a non-associative combine such as float addition */
+    template <class R, class Map, class Combine>
+    R parallel_reduce(std::size_t n, std::size_t grain, R init, Map &&map, Combine &&combine) {
+        grain = std::max(grain, std::size_t(1));
+        std::vector<std::optional<R>> partials((n + grain - 1) / grain);
+        parallel_for(n, grain, [&] (std::size_t begin, std::size_t end) {
+            partials[begin / grain].emplace(map(begin, end));
+        });
+        for (auto &partial: partials) {
+            init = combine(std::move(init), std::move(*partial));
+        }
+        return init;
+    }
+
     static bool stop_requested() noexcept {
         return m_tls.this_thread->m_thread.get_stop_token().stop_requested();
     }
 
-    static ThreadPool &this_pool() noexcept {
+    static BasicThreadPool &this_pool() noexcept {
         if (!m_tls.this_pool) [[unlikely]] std::terminate();
         return *m_tls.this_pool;
     }
 
-    static ThreadPool &default_pool() noexcept {
-        static ThreadPool pool;
+    static BasicThreadPool &default_pool() noexcept {
+        static BasicThreadPool pool;
         return pool;
     }
 
@@ -176,4 +258,13 @@ struct ThreadPool {
     }
 };
 
+using ThreadPool = BasicThreadPool<>;
+
+/* never allocates once constructed, for latency-critical pools: tasks live inline in
+ * fixed rings of QueueCapacity per worker, and a push into a full ring waits for room.
+ * tasks must fit in Capacity bytes and, as inplace_function requires, be copyable */
+template <std::size_t Capacity = 64, std::size_t QueueCapacity = 256>
+using InplaceThreadPool = BasicThreadPool<constl::inplace_function<void(), Capacity>,
+                                          BoundedQueue<constl::inplace_function<void(), Capacity>, QueueCapacity>>;
+
 }
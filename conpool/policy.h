@@ -0,0 +1,24 @@
+#pragma once
+
+namespace conpool::policy {
+
+/* execution policy tags for containers that can fan work out to a pool; Parallel only
+ * holds a reference, so any conpool thread pool fits */
+struct Sequential {};
+
+template <class Pool>
+struct Parallel {
+    Pool &pool;
+};
+
+template <class Pool>
+Parallel(Pool &) -> Parallel<Pool>;
+
+inline constexpr Sequential seq{};
+
+template <class Pool>
+Parallel<Pool> par(Pool &pool) noexcept {
+    return {pool};
+}
+
+}
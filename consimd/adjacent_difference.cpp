@@ -45,7 +45,8 @@ static void adjacent_difference_f32_avx(float const *__restrict in, float *__res
     }
 }
 
-static void adjacent_difference_i32_avx(int const *__restrict in, int *__restrict out, size_t size, int prev) {
+/* the lanes wrap around, and so does the scalar tail, so this serves int as well */
+static void adjacent_difference_u32_avx(uint32_t const *__restrict in, uint32_t *__restrict out, size_t size, uint32_t prev) {
     __m256i last, next, r, g, b, a, x, y, z, w, perm74560123;
     size_t i;
     i = 0;
@@ -71,9 +72,9 @@ static void adjacent_difference_i32_avx(int const *__restrict in, int *__restric
             last = next;
         }
     }
-    prev = _mm256_extract_epi32(last, 0);
+    prev = static_cast<uint32_t>(_mm256_extract_epi32(last, 0));
     for (; i < size; i++) {
-        int val = in[i];
+        uint32_t val = in[i];
         out[i] = val - prev;
         prev = val;
     }
@@ -86,7 +87,11 @@ void adjacent_difference<float, strategy::AVX>::operator()(float const *__restri
 }
 
 void adjacent_difference<int, strategy::AVX>::operator()(int const *__restrict in, int *__restrict out, size_t size, int prev) const {
-    return adjacent_difference_i32_avx(in, out, size, prev);
+    return adjacent_difference_u32_avx(reinterpret_cast<uint32_t const *>(in), reinterpret_cast<uint32_t *>(out), size, static_cast<uint32_t>(prev));
+}
+
+void adjacent_difference<uint32_t, strategy::AVX>::operator()(uint32_t const *__restrict in, uint32_t *__restrict out, size_t size, uint32_t prev) const {
+    return adjacent_difference_u32_avx(in, out, size, prev);
 }
 
 TEST_BEGIN()
@@ -108,8 +113,10 @@ TEST_PARAMS(AdjacentDifferenceRanges, {
 TEST_TYPES(AdjacentDifferenceTypes
            , std::tuple<int, strategy::AVX>
            , std::tuple<float, strategy::AVX>
+           , std::tuple<uint32_t, strategy::AVX>
            , std::tuple<int, strategy::Scalar>
            , std::tuple<float, strategy::Scalar>
+           , std::tuple<uint32_t, strategy::Scalar>
            );
 
 TEST_PT(AdjacentDifference, AdjacentDifferenceRanges, AdjacentDifferenceTypes) {
@@ -126,7 +133,7 @@ TEST_PT(AdjacentDifference, AdjacentDifferenceRanges, AdjacentDifferenceTypes) {
         if (i == 0) {
             EXPECT_NEAR(out[i], T(42 - 2718));
         } else {
-            EXPECT_NEAR(out[i], i);
+            EXPECT_NEAR(out[i], T(i));
         }
     }
 }
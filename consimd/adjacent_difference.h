@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include "strategy.h"
 
 namespace consimd {
@@ -25,5 +26,11 @@ template <>
 struct adjacent_difference<int, strategy::AVX> {
     void operator()(int const *__restrict in, int *__restrict out, size_t size, int prev) const;
 };
+
+/* the same as int but wrapping around, for differences that may not fit in an int */
+template <>
+struct adjacent_difference<uint32_t, strategy::AVX> {
+    void operator()(uint32_t const *__restrict in, uint32_t *__restrict out, size_t size, uint32_t prev) const;
+};
 }
 
@@ -0,0 +1,155 @@
+#include <x86intrin.h>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "delta_bitpack.h"
+#include "strategy.h"
+#include "../contest/test.h"
+
+namespace consimd {
+
+namespace {
+
+/* values 8k .. 8k + 7 of a block: row k of the eight lanes, which are b words apart */
+static inline __m256i delta_bitpack_unpack_row_avx(uint8_t const *words, unsigned b, size_t k, __m256i mask) {
+    if (!b) {
+        return _mm256_setzero_si256();
+    }
+    size_t off = k * b, w = off / 32, s = off % 32;
+    __m256i v = _mm256_srl_epi32(_mm256_loadu_si256((__m256i const *)words + w), _mm_cvtsi32_si128(s));
+    if (s + b > 32) {
+        __m256i hi = _mm256_loadu_si256((__m256i const *)words + w + 1);
+        v = _mm256_or_si256(v, _mm256_sll_epi32(hi, _mm_cvtsi32_si128(32 - s)));
+    }
+    return _mm256_and_si256(v, mask);
+}
+
+/* inclusive prefix sum of the eight lanes plus carry, which holds the previous sum in
+ * every lane */
+static inline __m256i delta_bitpack_scan_avx(__m256i x, __m256i carry) {
+    x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+    x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+    __m256i low = _mm256_shuffle_epi32(x, 0xff);
+    x = _mm256_add_epi32(x, _mm256_permute2x128_si256(low, low, 0x08));
+    return _mm256_add_epi32(x, carry);
+}
+
+static size_t delta_bitpack_decode_avx(uint8_t const *__restrict in, int *__restrict out, size_t n) {
+    constexpr size_t N = delta_bitpack_block_size;
+    alignas(32) uint32_t vals[N];
+    const __m256i last = _mm256_set1_epi32(7);
+    __m256i carry = _mm256_setzero_si256();
+    uint8_t const *p = in;
+    for (size_t i = 0; i < n; i += N) {
+        const size_t m = std::min(N, n - i);
+        uint32_t ref;
+        std::memcpy(&ref, p, 4);
+        unsigned b = p[4];
+        size_t nexc = p[5];
+        p += delta_bitpack_header_size;
+        uint8_t const *words = p;
+        p += b * 32;
+        const __m256i vref = _mm256_set1_epi32(ref);
+        const __m256i mask = _mm256_set1_epi32(_delta_bitpack_mask(b));
+
+        if (nexc == 0 && m == N) {
+            /* the common case: unpack, add the reference and scan in registers */
+            for (size_t k = 0; k < N / 8; k++) {
+                __m256i x = _mm256_add_epi32(delta_bitpack_unpack_row_avx(words, b, k, mask), vref);
+                x = delta_bitpack_scan_avx(x, carry);
+                _mm256_storeu_si256((__m256i *)(out + i + k * 8), x);
+                carry = _mm256_permutevar8x32_epi32(x, last);
+            }
+            continue;
+        }
+
+        for (size_t k = 0; k < N / 8; k++) {
+            _mm256_store_si256((__m256i *)(vals + k * 8), delta_bitpack_unpack_row_avx(words, b, k, mask));
+        }
+        for (size_t e = 0; e < nexc && b < 32; e++) {
+            uint32_t h;
+            std::memcpy(&h, p + nexc + e * 4, 4);
+            vals[p[e]] |= h << b;
+        }
+        p += nexc * 5;
+
+        size_t k = 0;
+        for (; k + 8 <= m; k += 8) {
+            __m256i x = _mm256_add_epi32(_mm256_load_si256((__m256i const *)(vals + k)), vref);
+            x = delta_bitpack_scan_avx(x, carry);
+            _mm256_storeu_si256((__m256i *)(out + i + k), x);
+            carry = _mm256_permutevar8x32_epi32(x, last);
+        }
+        uint32_t prev = _mm256_cvtsi256_si32(carry);
+        for (; k < m; k++) {
+            prev += vals[k] + ref;
+            out[i + k] = static_cast<int>(prev);
+        }
+        carry = _mm256_set1_epi32(prev);
+    }
+    return p - in;
+}
+
+}
+
+size_t delta_bitpack_decode<strategy::AVX>::operator()(uint8_t const *__restrict in, int *__restrict out, size_t n) const {
+    return delta_bitpack_decode_avx(in, out, n);
+}
+
+TEST_BEGIN()
+
+/* 0: sorted ids with the odd long gap, 1: timestamps with jitter, 2: a slow random walk,
+ * 3: wide noise */
+static void fill_test_column(int *out, size_t n, int pattern) {
+    unsigned seed = (unsigned)n * 4 + pattern;
+    int x = pattern == 1 ? 1600000000 : 0;
+    for (size_t i = 0; i < n; i++) {
+        seed = seed * 1103515245 + 12345;
+        unsigned r = seed >> 8;
+        switch (pattern) {
+        case 0: x += r % 97 ? r % 16 : 100000 + r % 1000; break;
+        case 1: x += 1000 + (int)(r % 64) - 32; break;
+        case 2: x += (int)(r % 17) - 8; break;
+        default: x = (int)(r % (1u << 20)) - (1 << 19) + (int)((seed >> 4) % 3 ? 0 : r << 6); break;
+        }
+        out[i] = x;
+    }
+}
+
+TEST_PARAMS(DeltaBitpackSizes, {
+    0, 1, 7, 8, 255, 256, 257, 511, 600, 1989, 4096,
+});
+
+TEST_TYPES(DeltaBitpackStrategies
+           , strategy::AVX
+           , strategy::Scalar
+           );
+
+TEST_PT(DeltaBitpackRoundTrip, DeltaBitpackSizes, DeltaBitpackStrategies) {
+    const size_t n = getTestParam();
+    alignas(64) static int in[4096];
+    for (int pattern = 0; pattern < 4; pattern++) {
+        fill_test_column(in, n, pattern);
+
+        std::vector<uint8_t> buf(delta_bitpack_max_length(n));
+        size_t len = delta_bitpack_encode<TestType>()(in, buf.data(), n);
+        std::vector<uint8_t> ref(delta_bitpack_max_length(n));
+        size_t ref_len = delta_bitpack_encode<strategy::Scalar>()(in, ref.data(), n);
+        EXPECT_EQ(len, ref_len);
+        EXPECT_EQ(std::equal(buf.begin(), buf.begin() + len, ref.begin()), true);
+        if (pattern != 3 && n >= 256) {
+            EXPECT_LT(len * 4, n * sizeof(int));
+        }
+
+        /* the decoder must not read past the encoded bytes */
+        std::vector<uint8_t> exact(buf.begin(), buf.begin() + len);
+        std::vector<int> out(n);
+        EXPECT_EQ(delta_bitpack_decode<TestType>()(exact.data(), out.data(), n), len);
+        EXPECT_EQ(std::equal(out.begin(), out.end(), in), true);
+    }
+}
+
+TEST_END()
+
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "adjacent_difference.h"
+#include "strategy.h"
+
+namespace consimd {
+
+/* delta + frame-of-reference + bit-packing with patched exceptions (PFOR) for sorted or
+ * slowly varying int columns. values are cut into blocks of 256 and each block stores:
+ *
+ *   uint32 ref, uint8 b, uint8 nexc     the smallest delta and the bit width
+ *   b * 32 bytes                        delta - ref of each value, low b bits, packed
+ *   uint8 pos[nexc], uint32 high[nexc]  the bits above b of the values that need them
+ *
+ * deltas are taken against the previous value, 0 before the first. the packing is
+ * vertical over 8 lanes: value i sits in lane i % 8 at bit (i / 8) * b of that lane's
+ * b words, and word w of lane j is 32-bit word w * 8 + j of the block, so one 256-bit
+ * load yields a word of every lane. a short last block is padded with zeros */
+
+inline constexpr size_t delta_bitpack_block_size = 256;
+inline constexpr size_t delta_bitpack_header_size = 6;
+
+/* b is chosen by cost and no exceptions at the widest b costs at most 32 * 32 bytes */
+inline constexpr size_t delta_bitpack_max_length(size_t n) {
+    return (n + delta_bitpack_block_size - 1) / delta_bitpack_block_size * (delta_bitpack_header_size + 32 * 32);
+}
+
+/* bytes taken by the block whose header starts at block */
+inline size_t delta_bitpack_block_length(uint8_t const *block) {
+    return delta_bitpack_header_size + size_t(block[4]) * 32 + size_t(block[5]) * 5;
+}
+
+inline constexpr uint32_t _delta_bitpack_mask(unsigned b) {
+    return b >= 32 ? ~uint32_t(0) : (uint32_t(1) << b) - 1;
+}
+
+/* encodes in[0, n) into out, which must hold delta_bitpack_max_length(n) bytes, returns
+ * the number of bytes written; the deltas are taken modulo 2^32 through
+ * adjacent_difference<uint32_t, Strategy>, whose vector path wants in 32-byte aligned */
+template <class Strategy>
+struct delta_bitpack_encode {
+    size_t operator()(int const *__restrict in, uint8_t *__restrict out, size_t n) const {
+        constexpr size_t N = delta_bitpack_block_size;
+        alignas(32) uint32_t deltas[N];
+        uint32_t vals[N];
+        uint32_t words[N];
+        uint8_t *p = out;
+        uint32_t prev = 0;
+        for (size_t i = 0; i < n; i += N) {
+            const size_t m = std::min(N, n - i);
+            adjacent_difference<uint32_t, Strategy>()(reinterpret_cast<uint32_t const *>(in + i), deltas, m, prev);
+            prev = static_cast<uint32_t>(in[i + m - 1]);
+
+            /* the smallest as a signed delta, so a column going down packs as well as one going up */
+            uint32_t ref = *std::min_element(deltas, deltas + m, [] (uint32_t a, uint32_t b) {
+                return static_cast<int32_t>(a) < static_cast<int32_t>(b);
+            });
+            size_t count[33] = {};
+            for (size_t k = 0; k < N; k++) {
+                vals[k] = k < m ? deltas[k] - ref : 0;
+                count[std::bit_width(vals[k])]++;
+            }
+
+            /* the narrowest width whose packing plus exceptions costs the least */
+            unsigned b = 32;
+            size_t nexc = 0, best = SIZE_MAX;
+            for (unsigned w = 33, above = 0; w-- > 0; ) {
+                size_t cost = w * 32 + above * 5;
+                if (above <= 255 && cost <= best) {
+                    best = cost;
+                    b = w;
+                    nexc = above;
+                }
+                above += count[w];
+            }
+
+            std::memcpy(p, &ref, 4);
+            p[4] = static_cast<uint8_t>(b);
+            p[5] = static_cast<uint8_t>(nexc);
+            p += delta_bitpack_header_size;
+
+            const uint32_t mask = _delta_bitpack_mask(b);
+            std::fill_n(words, b * 8, 0);
+            for (size_t k = 0; k < N && b; k++) {
+                uint32_t v = vals[k] & mask;
+                size_t off = k / 8 * b, w = off / 32, s = off % 32, j = k % 8;
+                words[w * 8 + j] |= v << s;
+                if (s + b > 32) {
+                    words[(w + 1) * 8 + j] |= v >> (32 - s);
+                }
+            }
+            std::memcpy(p, words, b * 32);
+            p += b * 32;
+
+            uint8_t *pos = p;
+            uint8_t *high = p + nexc;
+            for (size_t k = 0; k < N && b < 32; k++) {
+                if (vals[k] >> b) {
+                    *pos++ = static_cast<uint8_t>(k);
+                    uint32_t h = vals[k] >> b;
+                    std::memcpy(high, &h, 4);
+                    high += 4;
+                }
+            }
+            p += nexc * 5;
+        }
+        return p - out;
+    }
+};
+
+/* decodes n values from in into out, returns the number of bytes consumed */
+template <class Strategy>
+struct delta_bitpack_decode {
+    size_t operator()(uint8_t const *__restrict in, int *__restrict out, size_t n) const {
+        constexpr size_t N = delta_bitpack_block_size;
+        uint32_t words[N];
+        uint32_t vals[N];
+        uint8_t const *p = in;
+        uint32_t prev = 0;
+        for (size_t i = 0; i < n; i += N) {
+            const size_t m = std::min(N, n - i);
+            uint32_t ref;
+            std::memcpy(&ref, p, 4);
+            unsigned b = p[4];
+            size_t nexc = p[5];
+            p += delta_bitpack_header_size;
+
+            std::memcpy(words, p, b * 32);
+            p += b * 32;
+            const uint32_t mask = _delta_bitpack_mask(b);
+            for (size_t k = 0; k < m; k++) {
+                uint32_t v = 0;
+                if (b) {
+                    size_t off = k / 8 * b, w = off / 32, s = off % 32, j = k % 8;
+                    v = words[w * 8 + j] >> s;
+                    if (s + b > 32) {
+                        v |= words[(w + 1) * 8 + j] << (32 - s);
+                    }
+                }
+                vals[k] = v & mask;
+            }
+
+            for (size_t e = 0; e < nexc && b < 32; e++) {
+                uint32_t h;
+                std::memcpy(&h, p + nexc + e * 4, 4);
+                vals[p[e]] |= h << b;
+            }
+            p += nexc * 5;
+
+            for (size_t k = 0; k < m; k++) {
+                prev += vals[k] + ref;
+                out[i + k] = static_cast<int>(prev);
+            }
+        }
+        return p - in;
+    }
+};
+
+template <>
+struct delta_bitpack_decode<strategy::AVX> {
+    size_t operator()(uint8_t const *__restrict in, int *__restrict out, size_t n) const;
+};
+
+}
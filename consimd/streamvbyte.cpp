@@ -0,0 +1,155 @@
+#include <x86intrin.h>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "streamvbyte.h"
+#include "strategy.h"
+#include "../contest/test.h"
+
+namespace consimd {
+
+namespace {
+
+struct StreamVByteTables {
+    uint8_t length[256];         /* data bytes of a group of four */
+    uint8_t decode[256][16];     /* pshufb: packed data bytes -> four 32-bit lanes */
+    uint8_t encode[256][16];     /* pshufb: four 32-bit lanes -> packed data bytes */
+
+    constexpr StreamVByteTables() : length{}, decode{}, encode{} {
+        for (int c = 0; c < 256; c++) {
+            int pos = 0;
+            for (int lane = 0; lane < 4; lane++) {
+                int len = (c >> (lane * 2) & 3) + 1;
+                for (int k = 0; k < 4; k++) {
+                    decode[c][lane * 4 + k] = k < len ? pos + k : 0x80;
+                }
+                for (int k = 0; k < len; k++) {
+                    encode[c][pos + k] = lane * 4 + k;
+                }
+                pos += len;
+            }
+            for (int k = pos; k < 16; k++) {
+                encode[c][k] = 0x80;
+            }
+            length[c] = pos;
+        }
+    }
+};
+
+constexpr StreamVByteTables svb_tables;
+
+/* a group's 16-byte load or store runs at most 12 bytes past its own data, which the
+ * three groups after it are sure to cover, so the vector loops stop 16 values short */
+
+static size_t streamvbyte_encode_avx(uint32_t const *__restrict in, uint8_t *__restrict out, size_t n) {
+    uint8_t *control = out;
+    uint8_t *data = out + streamvbyte_control_length(n);
+    const __m128i ones = _mm_set1_epi32(1);
+    const __m128i lanes_low_bytes = _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 4) {
+        __m128i x = _mm_loadu_si128((__m128i const *)(in + i));
+        /* code = (x > 0xff) + (x > 0xffff) + (x > 0xffffff), with unsigned compares via min */
+        __m128i gt1 = _mm_andnot_si128(_mm_cmpeq_epi32(_mm_min_epu32(x, _mm_set1_epi32(0xff)), x), ones);
+        __m128i gt2 = _mm_andnot_si128(_mm_cmpeq_epi32(_mm_min_epu32(x, _mm_set1_epi32(0xffff)), x), ones);
+        __m128i gt3 = _mm_andnot_si128(_mm_cmpeq_epi32(_mm_min_epu32(x, _mm_set1_epi32(0xffffff)), x), ones);
+        __m128i code = _mm_add_epi32(_mm_add_epi32(gt1, gt2), gt3);
+        uint32_t codes = _mm_cvtsi128_si32(_mm_shuffle_epi8(code, lanes_low_bytes));
+        uint8_t c = static_cast<uint8_t>((codes & 0x03) | (codes >> 6 & 0x0c) | (codes >> 12 & 0x30) | (codes >> 18 & 0xc0));
+        control[i / 4] = c;
+        __m128i packed = _mm_shuffle_epi8(x, _mm_loadu_si128((__m128i const *)svb_tables.encode[c]));
+        _mm_storeu_si128((__m128i *)data, packed);
+        data += svb_tables.length[c];
+    }
+    for (; i < n; i++) {
+        uint32_t x = in[i];
+        size_t code = _streamvbyte_code(x);
+        if (i % 4 == 0) {
+            control[i / 4] = 0;
+        }
+        control[i / 4] |= code << (i % 4 * 2);
+        for (size_t k = 0; k <= code; k++) {
+            *data++ = static_cast<uint8_t>(x >> (k * 8));
+        }
+    }
+    return data - out;
+}
+
+static size_t streamvbyte_decode_avx(uint8_t const *__restrict in, uint32_t *__restrict out, size_t n) {
+    uint8_t const *control = in;
+    uint8_t const *data = in + streamvbyte_control_length(n);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 4) {
+        uint8_t c = control[i / 4];
+        __m128i packed = _mm_loadu_si128((__m128i const *)data);
+        __m128i x = _mm_shuffle_epi8(packed, _mm_loadu_si128((__m128i const *)svb_tables.decode[c]));
+        _mm_storeu_si128((__m128i *)(out + i), x);
+        data += svb_tables.length[c];
+    }
+    for (; i < n; i++) {
+        size_t code = control[i / 4] >> (i % 4 * 2) & 3;
+        uint32_t x = 0;
+        for (size_t k = 0; k <= code; k++) {
+            x |= uint32_t(*data++) << (k * 8);
+        }
+        out[i] = x;
+    }
+    return data - in;
+}
+
+}
+
+size_t streamvbyte_encode<strategy::AVX>::operator()(uint32_t const *__restrict in, uint8_t *__restrict out, size_t n) const {
+    return streamvbyte_encode_avx(in, out, n);
+}
+
+size_t streamvbyte_decode<strategy::AVX>::operator()(uint8_t const *__restrict in, uint32_t *__restrict out, size_t n) const {
+    return streamvbyte_decode_avx(in, out, n);
+}
+
+TEST_BEGIN()
+
+static void fill_test_ids(std::vector<uint32_t> &v, size_t n, unsigned seed) {
+    static const uint32_t edges[] = {
+        0, 1, 0xff, 0x100, 0xffff, 0x10000, 0xffffff, 0x1000000, 0xffffffff,
+    };
+    for (size_t i = 0; i < n; i++) {
+        seed = seed * 1103515245 + 12345;
+        /* mostly small ids with the odd wide one */
+        uint32_t r = seed >> 8;
+        v.push_back((seed >> 4) % 8 ? r % 300 : (seed >> 4) % 3 ? r : edges[r % std::size(edges)]);
+    }
+}
+
+TEST_PARAMS(StreamVByteSizes, {
+    0, 1, 3, 4, 5, 15, 16, 17, 31, 64, 100, 129, 711, 1989,
+});
+
+TEST_TYPES(StreamVByteStrategies
+           , strategy::AVX
+           , strategy::Scalar
+           );
+
+TEST_PT(StreamVByteRoundTrip, StreamVByteSizes, StreamVByteStrategies) {
+    const size_t n = getTestParam();
+    std::vector<uint32_t> in;
+    fill_test_ids(in, n, (unsigned)n);
+
+    std::vector<uint8_t> buf(streamvbyte_max_length(n));
+    size_t len = streamvbyte_encode<TestType>()(in.data(), buf.data(), n);
+    std::vector<uint8_t> ref(streamvbyte_max_length(n));
+    size_t ref_len = streamvbyte_encode<strategy::Scalar>()(in.data(), ref.data(), n);
+    EXPECT_EQ(len, ref_len);
+    EXPECT_EQ(std::equal(buf.begin(), buf.begin() + len, ref.begin()), true);
+    EXPECT_EQ(streamvbyte_control_length(n) + streamvbyte_data_length(buf.data(), n), len);
+
+    /* the decoder must not read past the encoded bytes */
+    std::vector<uint8_t> exact(buf.begin(), buf.begin() + len);
+    std::vector<uint32_t> out(n);
+    EXPECT_EQ(streamvbyte_decode<TestType>()(exact.data(), out.data(), n), len);
+    EXPECT_EQ(out == in, true);
+}
+
+TEST_END()
+
+}
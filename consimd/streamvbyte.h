@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "strategy.h"
+
+namespace consimd {
+
+/* Stream VByte (Lemire, Kurz & Rupp): n 32-bit values are stored as (n + 3) / 4 control
+ * bytes, each holding four 2-bit byte lengths minus one, followed by the data bytes of
+ * every value in little-endian order with the leading zero bytes dropped */
+
+inline constexpr size_t streamvbyte_control_length(size_t n) {
+    return (n + 3) / 4;
+}
+
+inline constexpr size_t streamvbyte_max_length(size_t n) {
+    return streamvbyte_control_length(n) + 4 * n;
+}
+
+inline constexpr size_t _streamvbyte_code(uint32_t x) {
+    return (x > 0xff) + (x > 0xffff) + (x > 0xffffff);
+}
+
+/* bytes taken by the data section following control bytes for n values */
+inline size_t streamvbyte_data_length(uint8_t const *control, size_t n) {
+    size_t len = 0;
+    for (size_t i = 0; i < n; i++) {
+        len += (control[i / 4] >> (i % 4 * 2) & 3) + 1;
+    }
+    return len;
+}
+
+/* encodes in[0, n) into out, which must hold streamvbyte_max_length(n) bytes, returns the
+ * number of bytes written */
+template <class Strategy>
+struct streamvbyte_encode {
+    size_t operator()(uint32_t const *__restrict in, uint8_t *__restrict out, size_t n) const {
+        uint8_t *control = out;
+        uint8_t *data = out + streamvbyte_control_length(n);
+        for (size_t i = 0; i < n; i++) {
+            uint32_t x = in[i];
+            size_t code = _streamvbyte_code(x);
+            if (i % 4 == 0) {
+                control[i / 4] = 0;
+            }
+            control[i / 4] |= code << (i % 4 * 2);
+            for (size_t k = 0; k <= code; k++) {
+                *data++ = static_cast<uint8_t>(x >> (k * 8));
+            }
+        }
+        return data - out;
+    }
+};
+
+template <>
+struct streamvbyte_encode<strategy::AVX> {
+    size_t operator()(uint32_t const *__restrict in, uint8_t *__restrict out, size_t n) const;
+};
+
+/* decodes n values from in into out, returns the number of bytes consumed */
+template <class Strategy>
+struct streamvbyte_decode {
+    size_t operator()(uint8_t const *__restrict in, uint32_t *__restrict out, size_t n) const {
+        uint8_t const *control = in;
+        uint8_t const *data = in + streamvbyte_control_length(n);
+        for (size_t i = 0; i < n; i++) {
+            size_t code = control[i / 4] >> (i % 4 * 2) & 3;
+            uint32_t x = 0;
+            for (size_t k = 0; k <= code; k++) {
+                x |= uint32_t(*data++) << (k * 8);
+            }
+            out[i] = x;
+        }
+        return data - in;
+    }
+};
+
+template <>
+struct streamvbyte_decode<strategy::AVX> {
+    size_t operator()(uint8_t const *__restrict in, uint32_t *__restrict out, size_t n) const;
+};
+
+}
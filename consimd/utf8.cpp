@@ -0,0 +1,524 @@
+#include <x86intrin.h>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "utf8.h"
+#include "strategy.h"
+#include "../contest/test.h"
+
+namespace consimd {
+
+namespace {
+
+/* lookup-table validation of Keiser & Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte" */
+
+constexpr uint8_t TOO_SHORT = 1 << 0;
+constexpr uint8_t TOO_LONG = 1 << 1;
+constexpr uint8_t OVERLONG_3 = 1 << 2;
+constexpr uint8_t TOO_LARGE = 1 << 3;
+constexpr uint8_t SURROGATE = 1 << 4;
+constexpr uint8_t OVERLONG_2 = 1 << 5;
+constexpr uint8_t TOO_LARGE_1000 = 1 << 6;
+constexpr uint8_t OVERLONG_4 = 1 << 6;
+constexpr uint8_t TWO_CONTS = 1 << 7;
+constexpr uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+inline __m256i mm256_table16(uint8_t const (&t)[16]) {
+    __m128i x = _mm_loadu_si128((__m128i const *)t);
+    return _mm256_broadcastsi128_si256(x);
+}
+
+inline __m256i mm256_high_nibbles(__m256i x) {
+    return _mm256_and_si256(_mm256_srli_epi16(x, 4), _mm256_set1_epi8(0x0f));
+}
+
+inline __m256i mm256_low_nibbles(__m256i x) {
+    return _mm256_and_si256(x, _mm256_set1_epi8(0x0f));
+}
+
+/* bytes of input shifted right by N, with the last N bytes of prev shifted in */
+template <int N>
+inline __m256i mm256_prev(__m256i input, __m256i prev) {
+    return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - N);
+}
+
+struct utf8_checker {
+    __m256i byte_1_high_tbl, byte_1_low_tbl, byte_2_high_tbl, incomplete_max;
+    __m256i error, prev_input, prev_incomplete;
+
+    utf8_checker() {
+        static const uint8_t byte_1_high[16] = {
+            /* 0_______ ________ <ASCII in byte 1> */
+            TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+            TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+            /* 10______ ________ <continuation in byte 1> */
+            TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+            /* 1100____ ________ <two byte lead in byte 1> */
+            TOO_SHORT | OVERLONG_2,
+            /* 1101____ ________ <two byte lead in byte 1> */
+            TOO_SHORT,
+            /* 1110____ ________ <three byte lead in byte 1> */
+            TOO_SHORT | OVERLONG_3 | SURROGATE,
+            /* 1111____ ________ <four+ byte lead in byte 1> */
+            TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4,
+        };
+        static const uint8_t byte_1_low[16] = {
+            /* ____0000 ________ */
+            CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+            /* ____0001 ________ */
+            CARRY | OVERLONG_2,
+            /* ____001_ ________ */
+            CARRY,
+            CARRY,
+            /* ____0100 ________ */
+            CARRY | TOO_LARGE,
+            /* ____0101 ________ */
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            /* ____011_ ________ */
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            /* ____1___ ________ */
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            /* ____1101 ________ */
+            CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+        };
+        static const uint8_t byte_2_high[16] = {
+            /* ________ 0_______ <ASCII in byte 2> */
+            TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+            TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+            /* ________ 1000____ */
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+            /* ________ 1001____ */
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+            /* ________ 101_____ */
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+            /* ________ 11______ */
+            TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        };
+        byte_1_high_tbl = mm256_table16(byte_1_high);
+        byte_1_low_tbl = mm256_table16(byte_1_low);
+        byte_2_high_tbl = mm256_table16(byte_2_high);
+        /* a lead byte in the last 1, 2 or 3 positions still expects continuations */
+        incomplete_max = _mm256_setr_epi8(
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            (char)(0b11110000u - 1), (char)(0b11100000u - 1), (char)(0b11000000u - 1));
+        error = _mm256_setzero_si256();
+        prev_input = _mm256_setzero_si256();
+        prev_incomplete = _mm256_setzero_si256();
+    }
+
+    void check(__m256i input) {
+        if (_mm256_movemask_epi8(input) == 0) {
+            /* all ASCII: only a sequence left open by the previous block can fail */
+            error = _mm256_or_si256(error, prev_incomplete);
+        } else {
+            __m256i prev1 = mm256_prev<1>(input, prev_input);
+            __m256i sc = _mm256_and_si256(
+                _mm256_and_si256(
+                    _mm256_shuffle_epi8(byte_1_high_tbl, mm256_high_nibbles(prev1)),
+                    _mm256_shuffle_epi8(byte_1_low_tbl, mm256_low_nibbles(prev1))),
+                _mm256_shuffle_epi8(byte_2_high_tbl, mm256_high_nibbles(input)));
+            __m256i prev2 = mm256_prev<2>(input, prev_input);
+            __m256i prev3 = mm256_prev<3>(input, prev_input);
+            __m256i is_third_byte = _mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0b11100000u - 0x80)));
+            __m256i is_fourth_byte = _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0b11110000u - 0x80)));
+            __m256i must23_80 = _mm256_and_si256(_mm256_or_si256(is_third_byte, is_fourth_byte), _mm256_set1_epi8((char)0x80));
+            error = _mm256_or_si256(error, _mm256_xor_si256(must23_80, sc));
+        }
+        prev_incomplete = _mm256_subs_epu8(input, incomplete_max);
+        prev_input = input;
+    }
+
+    bool has_error() const {
+        return !_mm256_testz_si256(error, error);
+    }
+};
+
+inline size_t count_leading_bytes(__m256i input) {
+    /* everything but 0b10xxxxxx starts a code point */
+    __m256i lead = _mm256_cmpgt_epi8(input, _mm256_set1_epi8(-65));
+    return _mm_popcnt_u32((unsigned)_mm256_movemask_epi8(lead));
+}
+
+static size_t utf8_validate_avx(char8_t const *in, size_t size) {
+    utf8_checker checker;
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i input = _mm256_loadu_si256((__m256i const *)(in + i));
+        checker.check(input);
+        count += count_leading_bytes(input);
+    }
+    /* zero padding acts as ASCII, so a sequence cut short by the end is reported as TOO_SHORT */
+    alignas(32) char8_t tail[32] = {};
+    if (size != i) std::memcpy(tail, in + i, size - i);
+    __m256i input = _mm256_load_si256((__m256i const *)tail);
+    checker.check(input);
+    count += count_leading_bytes(input) - (32 - (size - i));
+    if (checker.has_error()) {
+        return utf8_invalid;
+    }
+    return count;
+}
+
+static size_t utf8_count_avx(char8_t const *in, size_t size) {
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        count += count_leading_bytes(_mm256_loadu_si256((__m256i const *)(in + i)));
+    }
+    return count + utf8_count<strategy::Scalar>()(in + i, size - i);
+}
+
+static size_t utf8_decode_avx(char8_t const *__restrict in, char32_t *__restrict out, size_t size) {
+    size_t i = 0, j = 0;
+    while (i + 32 <= size) {
+        __m256i input = _mm256_loadu_si256((__m256i const *)(in + i));
+        if (_mm256_movemask_epi8(input) == 0) {
+            __m128i lo = _mm256_castsi256_si128(input);
+            __m128i hi = _mm256_extracti128_si256(input, 1);
+            _mm256_storeu_si256((__m256i *)(out + j), _mm256_cvtepu8_epi32(lo));
+            _mm256_storeu_si256((__m256i *)(out + j + 8), _mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8)));
+            _mm256_storeu_si256((__m256i *)(out + j + 16), _mm256_cvtepu8_epi32(hi));
+            _mm256_storeu_si256((__m256i *)(out + j + 24), _mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8)));
+            i += 32;
+            j += 32;
+            continue;
+        }
+        /* a sequence may run past the window, the next window starts after it */
+        size_t end = i + 32;
+        while (i < end) {
+            size_t n = 1 + (in[i] >= 0xc0) + (in[i] >= 0xe0) + (in[i] >= 0xf0);
+            j += utf8_decode<strategy::Scalar>()(in + i, out + j, n);
+            i += n;
+        }
+    }
+    j += utf8_decode<strategy::Scalar>()(in + i, out + j, size - i);
+    return j;
+}
+
+
+inline size_t mm256_hsum_epi32(__m256i acc) {
+    alignas(32) uint32_t lanes[8];
+    _mm256_store_si256((__m256i *)lanes, acc);
+    size_t sum = 0;
+    for (uint32_t x: lanes) sum += x;
+    return sum;
+}
+
+/* mask of 32-bit lanes holding x >= y, unsigned */
+inline __m256i mm256_cmpge_epu32(__m256i x, __m256i y) {
+    return _mm256_cmpeq_epi32(_mm256_max_epu32(x, y), x);
+}
+
+static size_t utf8_encode_length_avx(char32_t const *in, size_t size) {
+    const __m256i c80 = _mm256_set1_epi32(0x80);
+    const __m256i c800 = _mm256_set1_epi32(0x800);
+    const __m256i c10000 = _mm256_set1_epi32(0x10000);
+    size_t len = size;
+    size_t i = 0;
+    while (i + 8 <= size) {
+        /* each lane grows by at most 3 per step, flush before it could overflow */
+        size_t end = i + std::min((size - i) & ~size_t(7), size_t(8) << 24);
+        __m256i acc = _mm256_setzero_si256();
+        for (; i != end; i += 8) {
+            __m256i x = _mm256_loadu_si256((__m256i const *)(in + i));
+            acc = _mm256_sub_epi32(acc, mm256_cmpge_epu32(x, c80));
+            acc = _mm256_sub_epi32(acc, mm256_cmpge_epu32(x, c800));
+            acc = _mm256_sub_epi32(acc, mm256_cmpge_epu32(x, c10000));
+        }
+        len += mm256_hsum_epi32(acc);
+    }
+    for (; i < size; i++) {
+        char32_t c = in[i];
+        len += (c >= 0x80) + (c >= 0x800) + (c >= 0x10000);
+    }
+    return len;
+}
+
+static size_t utf8_encode_avx(char32_t const *__restrict in, char8_t *__restrict out, size_t size) {
+    const __m256i non_ascii = _mm256_set1_epi32(~0x7f);
+    size_t i = 0, j = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m256i a = _mm256_loadu_si256((__m256i const *)(in + i));
+        __m256i b = _mm256_loadu_si256((__m256i const *)(in + i + 8));
+        if (_mm256_testz_si256(_mm256_or_si256(a, b), non_ascii)) {
+            /* packs interleave the 128-bit lanes, put a0-7 in the low lane and b0-7 in the high one */
+            __m256i p = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xd8);
+            __m256i q = _mm256_packus_epi16(p, p);
+            __m128i r = _mm_unpacklo_epi64(_mm256_castsi256_si128(q), _mm256_extracti128_si256(q, 1));
+            _mm_storeu_si128((__m128i *)(out + j), r);
+            j += 16;
+        } else {
+            j += utf8_encode<strategy::Scalar>()(in + i, out + j, 16);
+        }
+    }
+    j += utf8_encode<strategy::Scalar>()(in + i, out + j, size - i);
+    return j;
+}
+
+static size_t utf8_to_utf16_length_avx(char8_t const *in, size_t size) {
+    const __m256i cont_max = _mm256_set1_epi8(-65);
+    const __m256i lead4 = _mm256_set1_epi8((char)0xf0);
+    size_t len = 0;
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i x = _mm256_loadu_si256((__m256i const *)(in + i));
+        unsigned leads = _mm256_movemask_epi8(_mm256_cmpgt_epi8(x, cont_max));
+        unsigned quads = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(x, lead4), x));
+        len += _mm_popcnt_u32(leads) + _mm_popcnt_u32(quads);
+    }
+    return len + utf8_to_utf16_length<strategy::Scalar>()(in + i, size - i);
+}
+
+static size_t utf8_to_utf16_avx(char8_t const *__restrict in, char16_t *__restrict out, size_t size) {
+    size_t i = 0, j = 0;
+    while (i + 32 <= size) {
+        __m256i input = _mm256_loadu_si256((__m256i const *)(in + i));
+        if (_mm256_movemask_epi8(input) == 0) {
+            _mm256_storeu_si256((__m256i *)(out + j), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(input)));
+            _mm256_storeu_si256((__m256i *)(out + j + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(input, 1)));
+            i += 32;
+            j += 32;
+            continue;
+        }
+        size_t end = i + 32;
+        while (i < end) {
+            size_t n = 1 + (in[i] >= 0xc0) + (in[i] >= 0xe0) + (in[i] >= 0xf0);
+            j += utf8_to_utf16<strategy::Scalar>()(in + i, out + j, n);
+            i += n;
+        }
+    }
+    j += utf8_to_utf16<strategy::Scalar>()(in + i, out + j, size - i);
+    return j;
+}
+
+/* mask of 16-bit lanes holding x >= y, unsigned */
+inline __m256i mm256_cmpge_epu16(__m256i x, __m256i y) {
+    return _mm256_cmpeq_epi16(_mm256_max_epu16(x, y), x);
+}
+
+static size_t utf16_to_utf8_length_avx(char16_t const *in, size_t size) {
+    const __m256i c80 = _mm256_set1_epi16(0x80);
+    const __m256i c800 = _mm256_set1_epi16(0x800);
+    const __m256i surrogate_mask = _mm256_set1_epi16((short)0xfc00);
+    const __m256i high_surrogate = _mm256_set1_epi16((short)0xd800);
+    const __m256i low_surrogate = _mm256_set1_epi16((short)0xdc00);
+    size_t len = 0;
+    size_t i = 0;
+    /* the pair check peeks one unit ahead */
+    for (; i + 17 <= size; i += 16) {
+        __m256i x = _mm256_loadu_si256((__m256i const *)(in + i));
+        __m256i y = _mm256_loadu_si256((__m256i const *)(in + i + 1));
+        unsigned ge80 = _mm256_movemask_epi8(mm256_cmpge_epu16(x, c80));
+        unsigned ge800 = _mm256_movemask_epi8(mm256_cmpge_epu16(x, c800));
+        unsigned pairs = _mm256_movemask_epi8(_mm256_and_si256(
+            _mm256_cmpeq_epi16(_mm256_and_si256(x, surrogate_mask), high_surrogate),
+            _mm256_cmpeq_epi16(_mm256_and_si256(y, surrogate_mask), low_surrogate)));
+        /* movemask yields two bits per 16-bit lane */
+        len += 16 + (_mm_popcnt_u32(ge80) + _mm_popcnt_u32(ge800)) / 2 - _mm_popcnt_u32(pairs);
+    }
+    return len + utf16_to_utf8_length<strategy::Scalar>()(in + i, size - i);
+}
+
+static size_t utf16_to_utf8_avx(char16_t const *__restrict in, char8_t *__restrict out, size_t size) {
+    const __m256i non_ascii = _mm256_set1_epi16((short)0xff80);
+    size_t i = 0, j = 0;
+    while (i + 16 <= size) {
+        __m256i x = _mm256_loadu_si256((__m256i const *)(in + i));
+        if (_mm256_testz_si256(x, non_ascii)) {
+            __m128i r = _mm_packus_epi16(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+            _mm_storeu_si128((__m128i *)(out + j), r);
+            i += 16;
+            j += 16;
+            continue;
+        }
+        /* never end the window on a high surrogate, it may pair with the next unit */
+        size_t n = 16;
+        while (i + n < size && (in[i + n - 1] & 0xfc00) == 0xd800) {
+            n++;
+        }
+        j += utf16_to_utf8<strategy::Scalar>()(in + i, out + j, n);
+        i += n;
+    }
+    j += utf16_to_utf8<strategy::Scalar>()(in + i, out + j, size - i);
+    return j;
+}
+}
+
+size_t utf8_validate<strategy::AVX>::operator()(char8_t const *in, size_t size) const {
+    return utf8_validate_avx(in, size);
+}
+
+size_t utf8_decode<strategy::AVX>::operator()(char8_t const *__restrict in, char32_t *__restrict out, size_t size) const {
+    return utf8_decode_avx(in, out, size);
+}
+
+size_t utf8_count<strategy::AVX>::operator()(char8_t const *in, size_t size) const {
+    return utf8_count_avx(in, size);
+}
+
+size_t utf8_encode_length<strategy::AVX>::operator()(char32_t const *in, size_t size) const {
+    return utf8_encode_length_avx(in, size);
+}
+
+size_t utf8_encode<strategy::AVX>::operator()(char32_t const *__restrict in, char8_t *__restrict out, size_t size) const {
+    return utf8_encode_avx(in, out, size);
+}
+
+size_t utf8_to_utf16_length<strategy::AVX>::operator()(char8_t const *in, size_t size) const {
+    return utf8_to_utf16_length_avx(in, size);
+}
+
+size_t utf8_to_utf16<strategy::AVX>::operator()(char8_t const *__restrict in, char16_t *__restrict out, size_t size) const {
+    return utf8_to_utf16_avx(in, out, size);
+}
+
+size_t utf16_to_utf8_length<strategy::AVX>::operator()(char16_t const *in, size_t size) const {
+    return utf16_to_utf8_length_avx(in, size);
+}
+
+size_t utf16_to_utf8<strategy::AVX>::operator()(char16_t const *__restrict in, char8_t *__restrict out, size_t size) const {
+    return utf16_to_utf8_avx(in, out, size);
+}
+
+TEST_BEGIN()
+
+static void fill_test_text(std::u8string &s, std::u32string &cps, size_t ncps, unsigned seed) {
+    static const char32_t samples[] = {
+        U'a', U'Z', U'0', U' ', U'\n', 0x7f, 0x80, 0xe9, 0x3b1, 0x7ff,
+        0x800, 0x4e2d, 0xd7ff, 0xe000, 0xfffd, 0xffff, 0x10000, 0x1f600, 0x10ffff,
+    };
+    for (size_t k = 0; k < ncps; k++) {
+        seed = seed * 1103515245 + 12345;
+        /* mostly ASCII runs, like the logs we ingest */
+        char32_t cp = (seed >> 16) % 4 ? char32_t('a' + (seed >> 8) % 26) : samples[(seed >> 16) % std::size(samples)];
+        cps.push_back(cp);
+        if (cp < 0x80) {
+            s.push_back(char8_t(cp));
+        } else if (cp < 0x800) {
+            s.push_back(char8_t(0xc0 | cp >> 6));
+            s.push_back(char8_t(0x80 | (cp & 0x3f)));
+        } else if (cp < 0x10000) {
+            s.push_back(char8_t(0xe0 | cp >> 12));
+            s.push_back(char8_t(0x80 | (cp >> 6 & 0x3f)));
+            s.push_back(char8_t(0x80 | (cp & 0x3f)));
+        } else {
+            s.push_back(char8_t(0xf0 | cp >> 18));
+            s.push_back(char8_t(0x80 | (cp >> 12 & 0x3f)));
+            s.push_back(char8_t(0x80 | (cp >> 6 & 0x3f)));
+            s.push_back(char8_t(0x80 | (cp & 0x3f)));
+        }
+    }
+}
+
+TEST_PARAMS(Utf8Sizes, {
+    0, 1, 7, 31, 32, 33, 64, 100, 129, 711, 1989,
+});
+
+TEST_TYPES(Utf8Strategies
+           , strategy::AVX
+           , strategy::Scalar
+           );
+
+TEST_PT(Utf8ValidateDecode, Utf8Sizes, Utf8Strategies) {
+    const size_t ncps = getTestParam();
+    std::u8string s;
+    std::u32string cps;
+    fill_test_text(s, cps, ncps, (unsigned)ncps);
+
+    EXPECT_EQ(utf8_validate<TestType>()(s.data(), s.size()), ncps);
+    EXPECT_EQ(utf8_count<TestType>()(s.data(), s.size()), ncps);
+    std::u32string out(ncps, 0);
+    EXPECT_EQ(utf8_decode<TestType>()(s.data(), out.data(), s.size()), ncps);
+    EXPECT_EQ(out.compare(cps), 0);
+}
+
+TEST_PT(Utf8ValidateRejects, Utf8Sizes, Utf8Strategies) {
+    static const std::u8string_view bad[] = {
+        u8"\x80",                 /* stray continuation */
+        u8"\xc0\x80",             /* overlong 2 */
+        u8"\xe0\x80\x80",         /* overlong 3 */
+        u8"\xf0\x80\x80\x80",     /* overlong 4 */
+        u8"\xed\xa0\x80",         /* surrogate */
+        u8"\xf4\x90\x80\x80",     /* above U+10FFFF */
+        u8"\xf5\x80\x80\x80",     /* invalid lead */
+        u8"\xe2\x82",             /* too short */
+        u8"\xe2\x82\x41",         /* too short */
+        u8"\xc3\xa9\xa9",         /* too long */
+    };
+    const size_t pos = getTestParam();
+    for (auto b: bad) {
+        std::u8string s(pos + 40, u8'x');
+        s.replace(pos, b.size(), b);
+        EXPECT_EQ(utf8_validate<TestType>()(s.data(), s.size()), utf8_invalid);
+        s.resize(pos + b.size());
+        EXPECT_EQ(utf8_validate<TestType>()(s.data(), s.size()), utf8_invalid);
+    }
+}
+
+static std::u16string to_utf16(std::u32string const &cps) {
+    std::u16string s;
+    for (char32_t c: cps) {
+        if (c < 0x10000) {
+            s.push_back(char16_t(c));
+        } else {
+            s.push_back(char16_t(0xd800 | (c - 0x10000) >> 10));
+            s.push_back(char16_t(0xdc00 | ((c - 0x10000) & 0x3ff)));
+        }
+    }
+    return s;
+}
+
+TEST_PT(Utf8EncodeTranscode, Utf8Sizes, Utf8Strategies) {
+    const size_t ncps = getTestParam();
+    std::u8string s;
+    std::u32string cps;
+    fill_test_text(s, cps, ncps, (unsigned)ncps + 1);
+    std::u16string s16 = to_utf16(cps);
+
+    EXPECT_EQ(utf8_encode_length<TestType>()(cps.data(), cps.size()), s.size());
+    std::u8string out8(s.size(), 0);
+    EXPECT_EQ(utf8_encode<TestType>()(cps.data(), out8.data(), cps.size()), s.size());
+    EXPECT_EQ(out8.compare(s), 0);
+
+    EXPECT_EQ(utf8_to_utf16_length<TestType>()(s.data(), s.size()), s16.size());
+    std::u16string out16(s16.size(), 0);
+    EXPECT_EQ(utf8_to_utf16<TestType>()(s.data(), out16.data(), s.size()), s16.size());
+    EXPECT_EQ(out16.compare(s16), 0);
+
+    EXPECT_EQ(utf16_to_utf8_length<TestType>()(s16.data(), s16.size()), s.size());
+    std::u8string back(s.size(), 0);
+    EXPECT_EQ(utf16_to_utf8<TestType>()(s16.data(), back.data(), s16.size()), s.size());
+    EXPECT_EQ(back.compare(s), 0);
+}
+
+TEST_PT(Utf16UnpairedSurrogates, Utf8Sizes, Utf8Strategies) {
+    const size_t pos = getTestParam();
+    static const std::u16string_view lone[] = {
+        u"\xd800", u"\xdc00", u"\xdc00\xd800", u"\xd800\xd800\xdc00",
+    };
+    for (auto l: lone) {
+        std::u16string s16(pos + 40, u'x');
+        s16.replace(pos, l.size(), l);
+        size_t len = utf16_to_utf8_length<strategy::Scalar>()(s16.data(), s16.size());
+        std::u8string expect(len, 0);
+        utf16_to_utf8<strategy::Scalar>()(s16.data(), expect.data(), s16.size());
+        EXPECT_EQ(utf16_to_utf8_length<TestType>()(s16.data(), s16.size()), len);
+        std::u8string out(len, 0);
+        EXPECT_EQ(utf16_to_utf8<TestType>()(s16.data(), out.data(), s16.size()), len);
+        EXPECT_EQ(out.compare(expect), 0);
+    }
+}
+
+TEST_END()
+
+}
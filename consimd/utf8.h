@@ -0,0 +1,246 @@
+#pragma once
+
+#include <cstddef>
+#include "strategy.h"
+
+namespace consimd {
+
+inline constexpr size_t utf8_invalid = (size_t)-1;
+
+/* returns the number of code points in in[0, size), or utf8_invalid if it is not well-formed UTF-8 */
+template <class Strategy>
+struct utf8_validate {
+    size_t operator()(char8_t const *in, size_t size) const {
+        size_t count = 0;
+        for (size_t i = 0; i < size; count++) {
+            unsigned char c = in[i];
+            if (c < 0x80) {
+                i += 1;
+                continue;
+            }
+            size_t n;
+            unsigned char lo = 0x80, hi = 0xbf;
+            if (c >= 0xc2 && c <= 0xdf) {
+                n = 2;
+            } else if (c >= 0xe0 && c <= 0xef) {
+                n = 3;
+                if (c == 0xe0) lo = 0xa0; /* overlong */
+                if (c == 0xed) hi = 0x9f; /* surrogate */
+            } else if (c >= 0xf0 && c <= 0xf4) {
+                n = 4;
+                if (c == 0xf0) lo = 0x90; /* overlong */
+                if (c == 0xf4) hi = 0x8f; /* above U+10FFFF */
+            } else {
+                return utf8_invalid;
+            }
+            if (n > size - i) {
+                return utf8_invalid;
+            }
+            unsigned char c1 = in[i + 1];
+            if (c1 < lo || c1 > hi) {
+                return utf8_invalid;
+            }
+            for (size_t k = 2; k < n; k++) {
+                if ((in[i + k] & 0xc0) != 0x80) {
+                    return utf8_invalid;
+                }
+            }
+            i += n;
+        }
+        return count;
+    }
+};
+
+template <>
+struct utf8_validate<strategy::AVX> {
+    size_t operator()(char8_t const *in, size_t size) const;
+};
+
+/* decodes well-formed UTF-8 into UTF-32, returns the number of code points written */
+template <class Strategy>
+struct utf8_decode {
+    size_t operator()(char8_t const *__restrict in, char32_t *__restrict out, size_t size) const {
+        size_t j = 0;
+        for (size_t i = 0; i < size; j++) {
+            char32_t c = in[i];
+            if (c < 0x80) {
+                out[j] = c;
+                i += 1;
+            } else if (c < 0xe0) {
+                out[j] = (c & 0x1f) << 6 | (in[i + 1] & 0x3f);
+                i += 2;
+            } else if (c < 0xf0) {
+                out[j] = (c & 0x0f) << 12 | (in[i + 1] & 0x3f) << 6 | (in[i + 2] & 0x3f);
+                i += 3;
+            } else {
+                out[j] = (c & 0x07) << 18 | (in[i + 1] & 0x3f) << 12 | (in[i + 2] & 0x3f) << 6 | (in[i + 3] & 0x3f);
+                i += 4;
+            }
+        }
+        return j;
+    }
+};
+
+template <>
+struct utf8_decode<strategy::AVX> {
+    size_t operator()(char8_t const *__restrict in, char32_t *__restrict out, size_t size) const;
+};
+
+/* counts code points without validating, i.e. every byte but 0b10xxxxxx starts one */
+template <class Strategy>
+struct utf8_count {
+    size_t operator()(char8_t const *in, size_t size) const {
+        size_t count = 0;
+        for (size_t i = 0; i < size; i++) {
+            count += (in[i] & 0xc0) != 0x80;
+        }
+        return count;
+    }
+};
+
+template <>
+struct utf8_count<strategy::AVX> {
+    size_t operator()(char8_t const *in, size_t size) const;
+};
+
+/* number of bytes utf8_encode will write */
+template <class Strategy>
+struct utf8_encode_length {
+    size_t operator()(char32_t const *in, size_t size) const {
+        size_t len = 0;
+        for (size_t i = 0; i < size; i++) {
+            char32_t c = in[i];
+            len += 1 + (c >= 0x80) + (c >= 0x800) + (c >= 0x10000);
+        }
+        return len;
+    }
+};
+
+template <>
+struct utf8_encode_length<strategy::AVX> {
+    size_t operator()(char32_t const *in, size_t size) const;
+};
+
+/* encodes UTF-32 into UTF-8, returns the number of bytes written */
+template <class Strategy>
+struct utf8_encode {
+    size_t operator()(char32_t const *__restrict in, char8_t *__restrict out, size_t size) const {
+        size_t j = 0;
+        for (size_t i = 0; i < size; i++) {
+            char32_t c = in[i];
+            if (c < 0x80) {
+                out[j++] = char8_t(c);
+            } else if (c < 0x800) {
+                out[j++] = char8_t(0xc0 | c >> 6);
+                out[j++] = char8_t(0x80 | (c & 0x3f));
+            } else if (c < 0x10000) {
+                out[j++] = char8_t(0xe0 | c >> 12);
+                out[j++] = char8_t(0x80 | (c >> 6 & 0x3f));
+                out[j++] = char8_t(0x80 | (c & 0x3f));
+            } else {
+                out[j++] = char8_t(0xf0 | c >> 18);
+                out[j++] = char8_t(0x80 | (c >> 12 & 0x3f));
+                out[j++] = char8_t(0x80 | (c >> 6 & 0x3f));
+                out[j++] = char8_t(0x80 | (c & 0x3f));
+            }
+        }
+        return j;
+    }
+};
+
+template <>
+struct utf8_encode<strategy::AVX> {
+    size_t operator()(char32_t const *__restrict in, char8_t *__restrict out, size_t size) const;
+};
+
+/* number of UTF-16 units utf8_to_utf16 will write for well-formed UTF-8 */
+template <class Strategy>
+struct utf8_to_utf16_length {
+    size_t operator()(char8_t const *in, size_t size) const {
+        size_t len = 0;
+        for (size_t i = 0; i < size; i++) {
+            len += ((in[i] & 0xc0) != 0x80) + (in[i] >= 0xf0);
+        }
+        return len;
+    }
+};
+
+template <>
+struct utf8_to_utf16_length<strategy::AVX> {
+    size_t operator()(char8_t const *in, size_t size) const;
+};
+
+/* transcodes well-formed UTF-8 into UTF-16, returns the number of units written */
+template <class Strategy>
+struct utf8_to_utf16 {
+    size_t operator()(char8_t const *__restrict in, char16_t *__restrict out, size_t size) const {
+        size_t j = 0;
+        for (size_t i = 0; i < size; ) {
+            size_t n = 1 + (in[i] >= 0xc0) + (in[i] >= 0xe0) + (in[i] >= 0xf0);
+            char32_t c;
+            utf8_decode<strategy::Scalar>()(in + i, &c, n);
+            i += n;
+            if (c < 0x10000) {
+                out[j++] = char16_t(c);
+            } else {
+                c -= 0x10000;
+                out[j++] = char16_t(0xd800 | c >> 10);
+                out[j++] = char16_t(0xdc00 | (c & 0x3ff));
+            }
+        }
+        return j;
+    }
+};
+
+template <>
+struct utf8_to_utf16<strategy::AVX> {
+    size_t operator()(char8_t const *__restrict in, char16_t *__restrict out, size_t size) const;
+};
+
+/* number of bytes utf16_to_utf8 will write; unpaired surrogates become U+FFFD */
+template <class Strategy>
+struct utf16_to_utf8_length {
+    size_t operator()(char16_t const *in, size_t size) const {
+        size_t len = 0;
+        for (size_t i = 0; i < size; i++) {
+            char16_t c = in[i];
+            len += 1 + (c >= 0x80) + (c >= 0x800);
+            if ((c & 0xfc00) == 0xd800 && i + 1 < size && (in[i + 1] & 0xfc00) == 0xdc00) {
+                len -= 2; /* a pair counted as 3 + 3 takes 4 */
+            }
+        }
+        return len;
+    }
+};
+
+template <>
+struct utf16_to_utf8_length<strategy::AVX> {
+    size_t operator()(char16_t const *in, size_t size) const;
+};
+
+/* transcodes UTF-16 into UTF-8, returns the number of bytes written; unpaired surrogates become U+FFFD */
+template <class Strategy>
+struct utf16_to_utf8 {
+    size_t operator()(char16_t const *__restrict in, char8_t *__restrict out, size_t size) const {
+        size_t j = 0;
+        for (size_t i = 0; i < size; i++) {
+            char32_t c = in[i];
+            if ((c & 0xf800) == 0xd800) {
+                if ((c & 0xfc00) == 0xd800 && i + 1 < size && (in[i + 1] & 0xfc00) == 0xdc00) {
+                    c = 0x10000 + ((c & 0x3ff) << 10 | (in[++i] & 0x3ff));
+                } else {
+                    c = 0xfffd;
+                }
+            }
+            j += utf8_encode<strategy::Scalar>()(&c, out + j, 1);
+        }
+        return j;
+    }
+};
+
+template <>
+struct utf16_to_utf8<strategy::AVX> {
+    size_t operator()(char16_t const *__restrict in, char8_t *__restrict out, size_t size) const;
+};
+
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <new>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <algorithm>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace constl {
+
+/* e.g. Align = 32 keeps the consimd AVX kernels on their aligned path */
+template <class T, std::size_t Align = 64>
+struct aligned_allocator {
+    static_assert((Align & (Align - 1)) == 0, "Align must be a power of two");
+    static_assert(Align >= alignof(T), "Align must not be weaker than alignof(T)");
+
+    using value_type = T;
+    using is_always_equal = std::true_type;
+
+    aligned_allocator() = default;
+
+    template <class U>
+    constexpr aligned_allocator(aligned_allocator<U, Align> const &) noexcept {}
+
+    template <class U>
+    struct rebind {
+        using other = aligned_allocator<U, Align>;
+    };
+
+    [[nodiscard]] T *allocate(std::size_t n) {
+        return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(Align)));
+    }
+
+    void deallocate(T *p, std::size_t n) noexcept {
+        ::operator delete(p, n * sizeof(T), std::align_val_t(Align));
+    }
+
+    template <class U>
+    constexpr bool operator==(aligned_allocator<U, Align> const &) const noexcept {
+        return true;
+    }
+};
+
+/* big allocations are mmap'ed on 2 MiB boundaries and advised for transparent
+ * huge pages, small ones fall back to aligned_allocator; if THP is disabled
+ * the madvise simply fails and we keep regular pages */
+template <class T>
+struct huge_page_allocator {
+    static constexpr std::size_t huge_page_size = std::size_t(2) << 20;
+    static constexpr std::size_t small_align = 64;
+
+    using value_type = T;
+    using is_always_equal = std::true_type;
+
+    huge_page_allocator() = default;
+
+    template <class U>
+    constexpr huge_page_allocator(huge_page_allocator<U> const &) noexcept {}
+
+    static constexpr bool is_huge(std::size_t bytes) noexcept {
+        return bytes >= huge_page_size;
+    }
+
+    static constexpr std::size_t round_up(std::size_t bytes) noexcept {
+        return (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+    }
+
+    [[nodiscard]] T *allocate(std::size_t n) {
+        std::size_t bytes = n * sizeof(T);
+#if defined(__linux__)
+        if (is_huge(bytes)) {
+            std::size_t len = round_up(bytes);
+            /* over-map by one huge page so we can trim to an aligned window */
+            void *raw = ::mmap(nullptr, len + huge_page_size, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (raw == MAP_FAILED) [[unlikely]] {
+                throw std::bad_alloc();
+            }
+            std::uintptr_t beg = reinterpret_cast<std::uintptr_t>(raw);
+            std::uintptr_t aligned = (beg + huge_page_size - 1) & ~(huge_page_size - 1);
+            if (aligned != beg) {
+                ::munmap(raw, aligned - beg);
+            }
+            std::size_t tail = beg + len + huge_page_size - (aligned + len);
+            if (tail) {
+                ::munmap(reinterpret_cast<void *>(aligned + len), tail);
+            }
+            ::madvise(reinterpret_cast<void *>(aligned), len, MADV_HUGEPAGE);
+            return reinterpret_cast<T *>(aligned);
+        }
+#endif
+        return static_cast<T *>(::operator new(bytes, std::align_val_t(std::max(small_align, alignof(T)))));
+    }
+
+    void deallocate(T *p, std::size_t n) noexcept {
+        std::size_t bytes = n * sizeof(T);
+#if defined(__linux__)
+        if (is_huge(bytes)) {
+            ::munmap(static_cast<void *>(p), round_up(bytes));
+            return;
+        }
+#endif
+        ::operator delete(p, bytes, std::align_val_t(std::max(small_align, alignof(T))));
+    }
+
+    template <class U>
+    constexpr bool operator==(huge_page_allocator<U> const &) const noexcept {
+        return true;
+    }
+};
+
+}
@@ -0,0 +1,92 @@
+#include <string>
+#include <vector>
+#include <thread>
+#include <stdexcept>
+#include "cow_ptr.h"
+#include "../contest/test.h"
+
+namespace constl {
+
+TEST_BEGIN()
+
+TEST(CowPtrWriteDetaches) {
+    auto a = make_cow<std::vector<int>>(3, 7);
+    cow_ptr<std::vector<int>> b = a;
+    EXPECT_EQ(a.get() == b.get(), true);
+    EXPECT_EQ(a.use_count(), 2);
+
+    /* the writer gets its own copy, the other owner keeps seeing the old value */
+    b.write().push_back(8);
+    EXPECT_EQ(a.get() == b.get(), false);
+    EXPECT_EQ(a->size(), 3);
+    EXPECT_EQ(b->size(), 4);
+    EXPECT_EQ(a.unique() && b.unique(), true);
+
+    /* a unique owner writes in place */
+    auto const *before = b.get();
+    b.write()[0] = 1;
+    EXPECT_EQ(b.get() == before, true);
+    EXPECT_EQ((*a)[0], 7);
+
+    /* copy assignment shares again, and a write on the other side detaches the same way */
+    a = b;
+    EXPECT_EQ(a.get() == b.get(), true);
+    a.write().clear();
+    EXPECT_EQ(a->empty(), true);
+    EXPECT_EQ(b->size(), 4);
+}
+
+TEST(CowPtrWriteOnNull) {
+    cow_ptr<std::string> p;
+    EXPECT_EQ((bool)p, false);
+    EXPECT_EQ(p.use_count(), 0);
+    p.write() += "abc";
+    EXPECT_EQ(*p == "abc", true);
+    EXPECT_EQ(p.unique(), true);
+
+    p.reset();
+    EXPECT_EQ(p.get() == nullptr, true);
+    EXPECT_EQ(p.write().empty(), true);
+
+    struct NoDefault {
+        int x;
+        explicit NoDefault(int x) : x(x) {}
+    };
+    cow_ptr<NoDefault> q = nullptr;
+    bool threw = false;
+    try {
+        q.write();
+    } catch (std::logic_error const &) {
+        threw = true;
+    }
+    EXPECT_EQ(threw, true);
+    EXPECT_EQ((bool)q, false);
+    q = make_cow<NoDefault>(5);
+    q.write().x++;
+    EXPECT_EQ(q->x, 6);
+}
+
+/* each thread detaches its own copy of a shared value; the shared one is never touched */
+TEST(CowPtrConcurrentWrites) {
+    auto shared = make_cow<std::vector<int>>(1000, 1);
+    std::vector<cow_ptr<std::vector<int>>> copies(8, shared);
+    {
+        std::vector<std::jthread> threads;
+        for (int t = 0; t < 8; t++) {
+            threads.emplace_back([&copies, t] {
+                for (int &x: copies[t].write()) {
+                    x = t;
+                }
+            });
+        }
+    }
+    bool ok = shared.unique() && (*shared)[999] == 1;
+    for (int t = 0; t < 8; t++) {
+        ok &= copies[t].unique() && (*copies[t])[0] == t && (*copies[t])[999] == t;
+    }
+    EXPECT_EQ(ok, true);
+}
+
+TEST_END()
+
+}
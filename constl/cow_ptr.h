@@ -0,0 +1,130 @@
+#pragma once
+
+#include <utility>
+#include <memory>
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+
+namespace constl {
+
+/* shares the pointee between copies and clones it on the first mutable access
+ * while shared; reads from many threads are safe, a single cow_ptr object must
+ * not be written and read concurrently (same rules as shared_ptr) */
+template <class T>
+struct cow_ptr {
+private:
+    struct Block {
+        std::atomic<std::size_t> m_refs;
+        T m_value;
+
+        template <class ...Args>
+        explicit Block(Args &&...args)
+        : m_refs(1), m_value(std::forward<Args>(args)...) {}
+    };
+
+    Block *m_blk;
+
+    explicit cow_ptr(Block *blk) noexcept : m_blk(blk) {}
+
+    void _release() noexcept {
+        if (m_blk && m_blk->m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete m_blk;
+        }
+    }
+
+public:
+    cow_ptr() noexcept : m_blk(nullptr) {}
+
+    cow_ptr(std::nullptr_t) noexcept : m_blk(nullptr) {}
+
+    template <class ...Args>
+    static cow_ptr make(Args &&...args) {
+        return cow_ptr(new Block(std::forward<Args>(args)...));
+    }
+
+    cow_ptr(cow_ptr const &that) noexcept : m_blk(that.m_blk) {
+        if (m_blk) m_blk->m_refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    cow_ptr(cow_ptr &&that) noexcept : m_blk(std::exchange(that.m_blk, nullptr)) {}
+
+    cow_ptr &operator=(cow_ptr const &that) noexcept {
+        if (m_blk != that.m_blk) {
+            if (that.m_blk) that.m_blk->m_refs.fetch_add(1, std::memory_order_relaxed);
+            _release();
+            m_blk = that.m_blk;
+        }
+        return *this;
+    }
+
+    cow_ptr &operator=(cow_ptr &&that) noexcept {
+        if (this != &that) {
+            _release();
+            m_blk = std::exchange(that.m_blk, nullptr);
+        }
+        return *this;
+    }
+
+    ~cow_ptr() noexcept {
+        _release();
+    }
+
+    void reset() noexcept {
+        _release();
+        m_blk = nullptr;
+    }
+
+    void swap(cow_ptr &that) noexcept {
+        std::swap(m_blk, that.m_blk);
+    }
+
+    T const *get() const noexcept {
+        return m_blk ? std::addressof(m_blk->m_value) : nullptr;
+    }
+
+    T const &operator*() const noexcept {
+        return m_blk->m_value;
+    }
+
+    T const *operator->() const noexcept {
+        return std::addressof(m_blk->m_value);
+    }
+
+    explicit operator bool() const noexcept {
+        return m_blk != nullptr;
+    }
+
+    std::size_t use_count() const noexcept {
+        return m_blk ? m_blk->m_refs.load(std::memory_order_relaxed) : 0;
+    }
+
+    bool unique() const noexcept {
+        return m_blk && m_blk->m_refs.load(std::memory_order_acquire) == 1;
+    }
+
+    /* detach from the other owners (deep-copying if shared) and return a mutable reference;
+     * a null cow_ptr gets a value-initialized T, or throws if T has no default constructor */
+    T &write() {
+        if (!m_blk) {
+            if constexpr (std::is_default_constructible_v<T>) {
+                m_blk = new Block();
+            } else {
+                throw std::logic_error("cow_ptr::write on null");
+            }
+        } else if (!unique()) {
+            Block *blk = new Block(std::as_const(m_blk->m_value));
+            _release();
+            m_blk = blk;
+        }
+        return m_blk->m_value;
+    }
+};
+
+template <class T, class ...Args>
+cow_ptr<T> make_cow(Args &&...args) {
+    return cow_ptr<T>::make(std::forward<Args>(args)...);
+}
+
+}
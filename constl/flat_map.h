@@ -35,7 +35,7 @@ private:
     using AllocU8Trait = std::allocator_traits<AllocU8Type>;
     using AllocKeyType = typename AllocTrait::template rebind_alloc<key_type>;
     using AllocKeyTrait = std::allocator_traits<AllocKeyType>;
-    using AllocMappedType = typename AllocTrait::template rebind_alloc<key_type>;
+    using AllocMappedType = typename AllocTrait::template rebind_alloc<mapped_type>;
     using AllocMappedTrait = std::allocator_traits<AllocMappedType>;
 
     template <class T>
@@ -47,8 +47,8 @@ private:
     
     private:
         constexpr explicit IteratorBase
-        ( size_t index
-        , flat_map const &parent
+        ( flat_map const &parent
+        , size_t index
         ) noexcept
         : m_keys(parent.m_keys + index)
         , m_vals(parent.m_vals + index)
@@ -108,9 +108,9 @@ private:
 
     template <class K2 = key_type>
     constexpr std::pair<size_t, bool> bucket_index_on
-    ( value_type *keys
-    , value_type *vals
-    , uint8_t *bitmaps
+    ( key_type const *keys
+    , mapped_type const *vals
+    , uint8_t const *bitmaps
     , size_t bucket_count
     , K2 const &k
     ) const noexcept {
@@ -131,7 +131,7 @@ public:
     using const_iterator = IteratorBase<const value_type>;
 
     constexpr allocator_type get_allocator() const noexcept {
-        return allocator_type();
+        return allocator_type(m_alloc_k);
     }
 
     constexpr key_equal key_eq() const noexcept {
@@ -288,7 +288,7 @@ public:
             std::construct_at(m_vals + h);
             ++m_size;
         }
-        return m_keys[h];
+        return m_vals[h];
     }
 
     template <class V2 = mapped_type>
@@ -354,9 +354,10 @@ public:
                 for (size_t h = 0; h < m_bucket_count; h++) {
                     if (!(m_bitmaps[h >> 3] & (1 << (h & 7)))) continue;
                     size_t h2 = bucket_index_on(keys, vals, bitmaps, n, m_keys[h]).first;
-                    std::construct_at(keys + h2, std::move(keys[h]));
-                    std::construct_at(vals + h2, std::move(vals[h]));
+                    std::construct_at(keys + h2, std::move(m_keys[h]));
+                    std::construct_at(vals + h2, std::move(m_vals[h]));
                     std::destroy_at(m_keys + h);
+                    std::destroy_at(m_vals + h);
                     bitmaps[h2 >> 3] |= 1 << (h2 & 7);
                 }
                 AllocKeyTrait::deallocate(m_alloc_k, m_keys, m_bucket_count);
@@ -390,7 +391,7 @@ public:
         return m_bucket_count;
     }
 
-    constexpr flat_map()
+    constexpr flat_map() requires std::default_initializable<allocator_type>
         : m_keys(nullptr)
         , m_vals(nullptr)
         , m_bitmaps(nullptr)
@@ -398,14 +399,30 @@ public:
         , m_size(0)
     {}
 
+    constexpr explicit flat_map(allocator_type const &alloc)
+        : m_keys(nullptr)
+        , m_vals(nullptr)
+        , m_bitmaps(nullptr)
+        , m_bucket_count(0)
+        , m_size(0)
+        , m_alloc_k(alloc)
+        , m_alloc_v(alloc)
+        , m_alloc_u8(alloc)
+    {}
+
     template <std::input_iterator InputIt, std::sentinel_for<InputIt> InputSen>
-    constexpr flat_map(InputIt first, InputSen last) {
-        while (first != last) {
-            insert(*first);
-            ++first;
-        }
+    constexpr flat_map(InputIt first, InputSen last, allocator_type const &alloc)
+        : flat_map(alloc)
+    {
+        insert(first, last);
     }
 
+    template <std::input_iterator InputIt, std::sentinel_for<InputIt> InputSen>
+    requires std::default_initializable<allocator_type>
+    constexpr flat_map(InputIt first, InputSen last)
+        : flat_map(std::move(first), std::move(last), allocator_type())
+    {}
+
     template <std::input_iterator InputIt, std::sentinel_for<InputIt> InputSen>
     constexpr void insert(InputIt first, InputSen last) {
         while (first != last) {
@@ -443,7 +460,11 @@ public:
         }
     }
 
-    constexpr flat_map(flat_map &&that) noexcept {
+    constexpr flat_map(flat_map &&that) noexcept
+        : m_alloc_k(that.m_alloc_k)
+        , m_alloc_v(that.m_alloc_v)
+        , m_alloc_u8(that.m_alloc_u8)
+    {
         m_keys = that.m_keys;
         that.m_keys = nullptr;
         m_vals = that.m_vals;
@@ -463,9 +484,14 @@ public:
                 std::destroy_at(m_vals + h);
             }
         }
-        AllocKeyTrait::deallocate(m_alloc_k, m_keys, m_bucket_count);
-        AllocMappedTrait::deallocate(m_alloc_v, m_vals, m_bucket_count);
-        AllocU8Trait::deallocate(m_alloc_u8, m_bitmaps, (m_bucket_count + 7) / 8);
+        if (m_bucket_count) {
+            AllocKeyTrait::deallocate(m_alloc_k, m_keys, m_bucket_count);
+            AllocMappedTrait::deallocate(m_alloc_v, m_vals, m_bucket_count);
+            AllocU8Trait::deallocate(m_alloc_u8, m_bitmaps, (m_bucket_count + 7) / 8);
+        }
+        m_alloc_k = that.m_alloc_k;
+        m_alloc_v = that.m_alloc_v;
+        m_alloc_u8 = that.m_alloc_u8;
 
         m_keys = that.m_keys;
         that.m_keys = nullptr;
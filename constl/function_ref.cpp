@@ -0,0 +1,99 @@
+#include <type_traits>
+#include "function_ref.h"
+#include "../contest/test.h"
+
+namespace constl {
+
+TEST_BEGIN()
+
+static int twice(int x) noexcept {
+    return x * 2;
+}
+
+static int thrice(int x) {
+    return x * 3;
+}
+
+struct Counter {
+    int base = 0;
+
+    int add(int x) {
+        return base += x;
+    }
+
+    int peek(int x) const noexcept {
+        return base + x;
+    }
+};
+
+static_assert(std::is_trivially_copyable_v<function_ref<int(int)>>);
+static_assert(sizeof(function_ref<int(int)>) == 2 * sizeof(void *));
+
+/* a const signature refuses callables that need to be mutable, a noexcept one refuses
+ * callables that may throw */
+static auto g_mutable_lambda = [n = 0] (int x) mutable { return n += x; };
+static auto g_throwing_lambda = [] (int x) { return x; };
+static_assert(std::is_constructible_v<function_ref<int(int)>, decltype(g_mutable_lambda) &>);
+static_assert(!std::is_constructible_v<function_ref<int(int) const>, decltype(g_mutable_lambda) &>);
+static_assert(!std::is_constructible_v<function_ref<int(int) noexcept>, decltype(g_throwing_lambda) &>);
+static_assert(!std::is_constructible_v<function_ref<int(int) noexcept>, decltype(&thrice)>);
+static_assert(!std::is_constructible_v<function_ref<int(int) const>, nontype_t<&Counter::add>, Counter &>);
+static_assert(!std::is_constructible_v<function_ref<int(int)>, nontype_t<&Counter::add>, Counter &&>);
+
+static int call(function_ref<int(int)> f, int x) {
+    return f(x);
+}
+
+TEST(FunctionRefPlain) {
+    int n = 0;
+    auto acc = [&n] (int x) mutable { return n += x; };
+    EXPECT_EQ(call(acc, 2), 2);
+    EXPECT_EQ(call(acc, 3), 5);
+    EXPECT_EQ(call(twice, 4), 8);
+    EXPECT_EQ(call(&thrice, 4), 12);
+    Counter c{10};
+    function_ref<int(int)> f(nontype<&Counter::add>, c);
+    EXPECT_EQ(f(5), 15);
+    EXPECT_EQ(c.base, 15);
+}
+
+TEST(FunctionRefConst) {
+    const int k = 7;
+    auto add_k = [k] (int x) { return x + k; };
+    function_ref<int(int) const> f = add_k;
+    EXPECT_EQ(f(1), 8);
+    EXPECT_EQ(function_ref<int(int) const>(thrice)(2), 6);
+    Counter const c{4};
+    function_ref<int(int) const> g(nontype<&Counter::peek>, c);
+    EXPECT_EQ(g(1), 5);
+}
+
+TEST(FunctionRefNoexcept) {
+    auto neg = [] (int x) noexcept { return -x; };
+    function_ref<int(int) noexcept> f = neg;
+    static_assert(noexcept(f(1)));
+    EXPECT_EQ(f(3), -3);
+    EXPECT_EQ(function_ref<int(int) noexcept>(twice)(5), 10);
+    function_ref g = twice; /* deduced as int(int) noexcept */
+    static_assert(std::is_same_v<decltype(g), function_ref<int(int) noexcept>>);
+    EXPECT_EQ(g(6), 12);
+    Counter c{1};
+    function_ref<int(int) noexcept> h(nontype<&Counter::peek>, c);
+    EXPECT_EQ(h(2), 3);
+}
+
+TEST(FunctionRefConstNoexcept) {
+    auto sq = [] (int x) noexcept { return x * x; };
+    function_ref<int(int) const noexcept> f = sq;
+    static_assert(noexcept(f(1)));
+    EXPECT_EQ(f(9), 81);
+    EXPECT_EQ(function_ref<int(int) const noexcept>(&twice)(7), 14);
+    Counter c{20};
+    function_ref<int(int) const noexcept> g(nontype<&Counter::peek>, c);
+    c.base = 30; /* bound by reference */
+    EXPECT_EQ(g(1), 31);
+}
+
+TEST_END()
+
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <functional>
+#include <type_traits>
+
+namespace constl {
+
+/* names a member function (or any constant callable) to bind together with an object,
+ * as in function_ref<void(int)>(nontype<&Widget::resize>, widget) */
+template <auto F>
+struct nontype_t {
+    explicit nontype_t() = default;
+};
+
+template <auto F>
+inline constexpr nontype_t<F> nontype{};
+
+template <class Fn>
+class function_ref {
+};
+
+namespace _function_ref_details {
+
+union bound_entity {
+    void *m_obj;
+    void const *m_cobj;
+    void (*m_fptr)();
+
+    constexpr bound_entity() noexcept : m_obj(nullptr) {}
+};
+
+template <bool Const, bool Noexcept, class Ret, class ...Args>
+class function_ref_base {
+protected:
+    using Invoker = Ret (*)(bound_entity, Args &&...) noexcept(Noexcept);
+
+    template <class Fn>
+    using qualified = std::conditional_t<Const, Fn const, Fn>;
+
+    template <class Fn, class ...Front>
+    static constexpr bool is_invocable_v = Noexcept
+        ? std::is_nothrow_invocable_r_v<Ret, Fn, Front..., Args...>
+        : std::is_invocable_r_v<Ret, Fn, Front..., Args...>;
+
+    bound_entity m_entity;
+    Invoker m_invoker;
+
+public:
+    template <class Fn, std::enable_if_t<
+        std::is_function_v<Fn> && is_invocable_v<Fn &>, int> = 0>
+    function_ref_base(Fn *fptr) noexcept
+    : m_invoker([] (bound_entity e, Args &&...args) noexcept(Noexcept) -> Ret {
+        return reinterpret_cast<Fn *>(e.m_fptr)(std::forward<Args>(args)...);
+    })
+    {
+        m_entity.m_fptr = reinterpret_cast<void (*)()>(fptr);
+    }
+
+    template <class Fn, std::enable_if_t<
+        !std::is_base_of_v<function_ref_base, std::remove_cvref_t<Fn>> &&
+        !std::is_member_pointer_v<std::remove_reference_t<Fn>> &&
+        !std::is_function_v<std::remove_pointer_t<std::remove_reference_t<Fn>>> &&
+        is_invocable_v<qualified<std::remove_reference_t<Fn>> &>, int> = 0>
+    function_ref_base(Fn &&fn) noexcept
+    : m_invoker([] (bound_entity e, Args &&...args) noexcept(Noexcept) -> Ret {
+        using Obj = qualified<std::remove_reference_t<Fn>>;
+        if constexpr (std::is_const_v<Obj>) {
+            return (*static_cast<Obj *>(e.m_cobj))(std::forward<Args>(args)...);
+        } else {
+            return (*static_cast<Obj *>(e.m_obj))(std::forward<Args>(args)...);
+        }
+    })
+    {
+        if constexpr (std::is_const_v<qualified<std::remove_reference_t<Fn>>>) {
+            m_entity.m_cobj = std::addressof(fn);
+        } else {
+            m_entity.m_obj = std::addressof(fn);
+        }
+    }
+
+    /* F called on obj, which must outlive the function_ref like any bound callable */
+    template <auto F, class Obj, std::enable_if_t<
+        !std::is_rvalue_reference_v<Obj &&> &&
+        is_invocable_v<decltype(F), qualified<std::remove_reference_t<Obj>> &>, int> = 0>
+    function_ref_base(nontype_t<F>, Obj &&obj) noexcept
+    : m_invoker([] (bound_entity e, Args &&...args) noexcept(Noexcept) -> Ret {
+        using Self = qualified<std::remove_reference_t<Obj>>;
+        if constexpr (std::is_const_v<Self>) {
+            return static_cast<Ret>(std::invoke(F, *static_cast<Self *>(e.m_cobj), std::forward<Args>(args)...));
+        } else {
+            return static_cast<Ret>(std::invoke(F, *static_cast<Self *>(e.m_obj), std::forward<Args>(args)...));
+        }
+    })
+    {
+        if constexpr (std::is_const_v<qualified<std::remove_reference_t<Obj>>>) {
+            m_entity.m_cobj = std::addressof(obj);
+        } else {
+            m_entity.m_obj = std::addressof(obj);
+        }
+    }
+
+    Ret operator()(Args ...args) const noexcept(Noexcept) {
+        return m_invoker(m_entity, std::forward<Args>(args)...);
+    }
+};
+
+}
+
+template <class Ret, class ...Args>
+class function_ref<Ret(Args...)>
+    : public _function_ref_details::function_ref_base<false, false, Ret, Args...> {
+public:
+    using _function_ref_details::function_ref_base<false, false, Ret, Args...>::function_ref_base;
+};
+
+template <class Ret, class ...Args>
+class function_ref<Ret(Args...) const>
+    : public _function_ref_details::function_ref_base<true, false, Ret, Args...> {
+public:
+    using _function_ref_details::function_ref_base<true, false, Ret, Args...>::function_ref_base;
+};
+
+template <class Ret, class ...Args>
+class function_ref<Ret(Args...) noexcept>
+    : public _function_ref_details::function_ref_base<false, true, Ret, Args...> {
+public:
+    using _function_ref_details::function_ref_base<false, true, Ret, Args...>::function_ref_base;
+};
+
+template <class Ret, class ...Args>
+class function_ref<Ret(Args...) const noexcept>
+    : public _function_ref_details::function_ref_base<true, true, Ret, Args...> {
+public:
+    using _function_ref_details::function_ref_base<true, true, Ret, Args...>::function_ref_base;
+};
+
+template <class Ret, class ...Args>
+function_ref(Ret (*)(Args...)) -> function_ref<Ret(Args...)>;
+
+template <class Ret, class ...Args>
+function_ref(Ret (*)(Args...) noexcept) -> function_ref<Ret(Args...) noexcept>;
+
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <cstddef>
+#include <type_traits>
+
+namespace constl {
+
+/* a copyable function wrapper that stores the callable in Capacity bytes of its own and
+ * never allocates; like std::function the callable must be copy constructible, so
+ * lambdas capturing a unique_ptr or other move-only state are rejected at compile time
+ * (keep such state outside and capture a pointer to it) */
+template <class Fn, std::size_t Capacity = 64, std::size_t Align = alignof(std::max_align_t)>
+class inplace_function {
+};
+
+namespace _inplace_function_details {
+
+template <bool Noexcept, class Ret, class ...Args>
+struct vtable {
+    Ret (*m_invoke)(void *, Args &&...) noexcept(Noexcept);
+    void (*m_copy)(void *, void const *);
+    void (*m_move)(void *, void *) noexcept;
+    void (*m_destroy)(void *) noexcept;
+};
+
+template <bool Const, bool Noexcept, class Fn, class Ret, class ...Args>
+inline constexpr vtable<Noexcept, Ret, Args...> vtable_for = {
+    [] (void *p, Args &&...args) noexcept(Noexcept) -> Ret {
+        using QFn = std::conditional_t<Const, Fn const, Fn>;
+        return (*static_cast<QFn *>(p))(std::forward<Args>(args)...);
+    },
+    [] (void *dst, void const *src) {
+        std::construct_at(static_cast<Fn *>(dst), *static_cast<Fn const *>(src));
+    },
+    [] (void *dst, void *src) noexcept {
+        std::construct_at(static_cast<Fn *>(dst), std::move(*static_cast<Fn *>(src)));
+    },
+    [] (void *p) noexcept {
+        std::destroy_at(static_cast<Fn *>(p));
+    },
+};
+
+template <bool Const, bool Noexcept, std::size_t Capacity, std::size_t Align, class Ret, class ...Args>
+class inplace_function_base {
+    using VTable = vtable<Noexcept, Ret, Args...>;
+
+    template <class Fn>
+    static constexpr bool is_invocable_v = Noexcept
+        ? std::is_nothrow_invocable_r_v<Ret, std::conditional_t<Const, Fn const, Fn> &, Args...>
+        : std::is_invocable_r_v<Ret, std::conditional_t<Const, Fn const, Fn> &, Args...>;
+
+    VTable const *m_vtable;
+    alignas(Align) mutable std::byte m_storage[Capacity];
+
+public:
+    inplace_function_base() noexcept : m_vtable(nullptr) {}
+
+    inplace_function_base(std::nullptr_t) noexcept : m_vtable(nullptr) {}
+
+    template <class Fn, std::enable_if_t<
+        !std::is_base_of_v<inplace_function_base, std::remove_cvref_t<Fn>> &&
+        is_invocable_v<std::decay_t<Fn>>, int> = 0>
+    inplace_function_base(Fn &&fn) noexcept(std::is_nothrow_constructible_v<std::decay_t<Fn>, Fn>) {
+        using F = std::decay_t<Fn>;
+        static_assert(sizeof(F) <= Capacity, "inplace_function: callable does not fit in Capacity");
+        static_assert(Align % alignof(F) == 0, "inplace_function: callable is over-aligned for Align");
+        static_assert(std::is_copy_constructible_v<F>, "inplace_function: callable must be copy constructible");
+        static_assert(std::is_nothrow_move_constructible_v<F>, "inplace_function: callable must be nothrow move constructible");
+        std::construct_at(reinterpret_cast<F *>(m_storage), std::forward<Fn>(fn));
+        m_vtable = &vtable_for<Const, Noexcept, F, Ret, Args...>;
+    }
+
+    inplace_function_base(inplace_function_base const &that) : m_vtable(nullptr) {
+        if (that.m_vtable) {
+            that.m_vtable->m_copy(m_storage, that.m_storage);
+            m_vtable = that.m_vtable;
+        }
+    }
+
+    inplace_function_base(inplace_function_base &&that) noexcept : m_vtable(that.m_vtable) {
+        if (m_vtable) {
+            m_vtable->m_move(m_storage, that.m_storage);
+        }
+    }
+
+    inplace_function_base &operator=(inplace_function_base const &that) {
+        if (this != &that) {
+            reset();
+            if (that.m_vtable) {
+                that.m_vtable->m_copy(m_storage, that.m_storage);
+                m_vtable = that.m_vtable;
+            }
+        }
+        return *this;
+    }
+
+    inplace_function_base &operator=(inplace_function_base &&that) noexcept {
+        if (this != &that) {
+            reset();
+            if (that.m_vtable) {
+                that.m_vtable->m_move(m_storage, that.m_storage);
+                m_vtable = that.m_vtable;
+            }
+        }
+        return *this;
+    }
+
+    ~inplace_function_base() noexcept {
+        reset();
+    }
+
+    void reset() noexcept {
+        if (m_vtable) {
+            m_vtable->m_destroy(m_storage);
+            m_vtable = nullptr;
+        }
+    }
+
+    bool valid() const noexcept {
+        return m_vtable != nullptr;
+    }
+
+    explicit operator bool() const noexcept {
+        return m_vtable != nullptr;
+    }
+
+    static constexpr std::size_t capacity() noexcept {
+        return Capacity;
+    }
+
+    static constexpr std::size_t alignment() noexcept {
+        return Align;
+    }
+
+protected:
+    Ret _invoke(Args &&...args) const noexcept(Noexcept) {
+        return m_vtable->m_invoke(m_storage, std::forward<Args>(args)...);
+    }
+};
+
+}
+
+template <class Ret, class ...Args, std::size_t Capacity, std::size_t Align>
+class inplace_function<Ret(Args...), Capacity, Align>
+    : public _inplace_function_details::inplace_function_base<false, false, Capacity, Align, Ret, Args...> {
+public:
+    using _inplace_function_details::inplace_function_base<false, false, Capacity, Align, Ret, Args...>::inplace_function_base;
+
+    Ret operator()(Args ...args) {
+        return this->_invoke(std::forward<Args>(args)...);
+    }
+};
+
+template <class Ret, class ...Args, std::size_t Capacity, std::size_t Align>
+class inplace_function<Ret(Args...) const, Capacity, Align>
+    : public _inplace_function_details::inplace_function_base<true, false, Capacity, Align, Ret, Args...> {
+public:
+    using _inplace_function_details::inplace_function_base<true, false, Capacity, Align, Ret, Args...>::inplace_function_base;
+
+    Ret operator()(Args ...args) const {
+        return this->_invoke(std::forward<Args>(args)...);
+    }
+};
+
+template <class Ret, class ...Args, std::size_t Capacity, std::size_t Align>
+class inplace_function<Ret(Args...) noexcept, Capacity, Align>
+    : public _inplace_function_details::inplace_function_base<false, true, Capacity, Align, Ret, Args...> {
+public:
+    using _inplace_function_details::inplace_function_base<false, true, Capacity, Align, Ret, Args...>::inplace_function_base;
+
+    Ret operator()(Args ...args) noexcept {
+        return this->_invoke(std::forward<Args>(args)...);
+    }
+};
+
+template <class Ret, class ...Args, std::size_t Capacity, std::size_t Align>
+class inplace_function<Ret(Args...) const noexcept, Capacity, Align>
+    : public _inplace_function_details::inplace_function_base<true, true, Capacity, Align, Ret, Args...> {
+public:
+    using _inplace_function_details::inplace_function_base<true, true, Capacity, Align, Ret, Args...>::inplace_function_base;
+
+    Ret operator()(Args ...args) const noexcept {
+        return this->_invoke(std::forward<Args>(args)...);
+    }
+};
+
+}
@@ -0,0 +1,73 @@
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include "monotonic_arena.h"
+#include "../contest/test.h"
+
+namespace constl {
+
+TEST_BEGIN()
+
+static bool aligned(void *p, std::size_t align) {
+    return reinterpret_cast<std::uintptr_t>(p) % align == 0;
+}
+
+TEST(MonotonicArenaAlignment) {
+    monotonic_arena arena(64);
+    bool ok = true;
+    for (std::size_t i = 0; i < 1000; i++) {
+        std::size_t align = std::size_t(1) << (i % 7);
+        void *p = arena.allocate(i % 13 + 1, align);
+        ok &= aligned(p, align);
+        std::memset(p, 0xab, i % 13 + 1);
+    }
+    EXPECT_EQ(ok, true);
+    /* a request bigger than the next chunk gets a chunk of its own */
+    void *big = arena.allocate(1 << 20, 64);
+    EXPECT_EQ(aligned(big, 64), true);
+    std::memset(big, 0, 1 << 20);
+}
+
+TEST(MonotonicArenaRewind) {
+    monotonic_arena arena(256);
+    void *first = arena.allocate(16, 16);
+    auto cp = arena.mark();
+    std::vector<void *> after;
+    for (int i = 0; i < 100; i++) {
+        after.push_back(arena.allocate(32, 16));
+    }
+    /* rewinding hands out the same addresses again, across chunk boundaries */
+    arena.rewind(cp);
+    bool same = true;
+    for (int i = 0; i < 100; i++) {
+        same &= arena.allocate(32, 16) == after[i];
+    }
+    EXPECT_EQ(same, true);
+    EXPECT_NE(arena.allocate(16, 16), first);
+
+    /* reset starts over from the first chunk, release gives everything back */
+    arena.reset();
+    EXPECT_EQ(arena.allocate(16, 16), first);
+    arena.release();
+    void *p = arena.allocate(16, 16);
+    EXPECT_EQ(aligned(p, 16), true);
+}
+
+TEST(MonotonicArenaAllocator) {
+    monotonic_arena arena;
+    std::vector<int, arena_allocator<int>> v{arena_allocator<int>(arena)};
+    for (int i = 0; i < 10000; i++) {
+        v.push_back(i);
+    }
+    bool ok = true;
+    for (int i = 0; i < 10000; i++) {
+        ok &= v[i] == i;
+    }
+    EXPECT_EQ(ok, true);
+    EXPECT_EQ(&v.get_allocator().resource() == &arena, true);
+    EXPECT_EQ(v.get_allocator() == arena_allocator<long>(arena), true);
+}
+
+TEST_END()
+
+}
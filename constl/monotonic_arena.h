@@ -0,0 +1,145 @@
+#pragma once
+
+#include <new>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include "resource_allocator.h"
+
+namespace constl {
+
+/* bump allocator: deallocate is a no-op, memory is reclaimed all at once
+ * by rewind() / reset(); chunks are kept around for reuse until release() */
+struct monotonic_arena {
+private:
+    struct Chunk {
+        Chunk *m_next;
+        std::size_t m_size;
+
+        std::byte *data() noexcept {
+            return reinterpret_cast<std::byte *>(this) + header_size();
+        }
+
+        static constexpr std::size_t header_size() noexcept {
+            return (sizeof(Chunk) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+        }
+    };
+
+    Chunk *m_head;
+    Chunk *m_chunk;
+    std::byte *m_ptr;
+    std::byte *m_end;
+    std::size_t m_next_size;
+
+    static std::byte *_align_up(std::byte *p, std::size_t align) noexcept {
+        return reinterpret_cast<std::byte *>((reinterpret_cast<std::uintptr_t>(p) + align - 1) & ~(align - 1));
+    }
+
+    void _enter(Chunk *chunk) noexcept {
+        m_chunk = chunk;
+        m_ptr = chunk->data();
+        m_end = chunk->data() + chunk->m_size;
+    }
+
+    void *_grow(std::size_t bytes, std::size_t align) {
+        std::size_t need = bytes + align;
+        /* reuse chunks left behind by an earlier rewind() */
+        while (m_chunk && m_chunk->m_next) {
+            _enter(m_chunk->m_next);
+            std::byte *p = _align_up(m_ptr, align);
+            if (p + bytes <= m_end) {
+                m_ptr = p + bytes;
+                return p;
+            }
+        }
+        std::size_t size = std::max(m_next_size, need);
+        m_next_size = size * 2;
+        Chunk *chunk = static_cast<Chunk *>(::operator new(Chunk::header_size() + size));
+        chunk->m_next = nullptr;
+        chunk->m_size = size;
+        if (m_chunk) {
+            m_chunk->m_next = chunk;
+        } else {
+            m_head = chunk;
+        }
+        _enter(chunk);
+        std::byte *p = _align_up(m_ptr, align);
+        m_ptr = p + bytes;
+        return p;
+    }
+
+public:
+    struct checkpoint {
+        Chunk *m_chunk;
+        std::byte *m_ptr;
+    };
+
+    explicit monotonic_arena(std::size_t initial_size = 4096) noexcept
+    : m_head(nullptr)
+    , m_chunk(nullptr)
+    , m_ptr(nullptr)
+    , m_end(nullptr)
+    , m_next_size(std::max(initial_size, std::size_t(64)))
+    {}
+
+    monotonic_arena(monotonic_arena &&) = delete;
+    monotonic_arena &operator=(monotonic_arena &&) = delete;
+    monotonic_arena(monotonic_arena const &) = delete;
+    monotonic_arena &operator=(monotonic_arena const &) = delete;
+
+    ~monotonic_arena() noexcept {
+        release();
+    }
+
+    [[nodiscard]] void *allocate(std::size_t bytes, std::size_t align = alignof(std::max_align_t)) {
+        std::byte *p = _align_up(m_ptr, align);
+        if (m_ptr && p + bytes <= m_end) [[likely]] {
+            m_ptr = p + bytes;
+            return p;
+        }
+        return _grow(bytes, align);
+    }
+
+    void deallocate(void *, std::size_t, std::size_t = alignof(std::max_align_t)) noexcept {
+    }
+
+    [[nodiscard]] checkpoint mark() const noexcept {
+        return {m_chunk, m_ptr};
+    }
+
+    /* free everything allocated after mark() in O(1) */
+    void rewind(checkpoint cp) noexcept {
+        if (!cp.m_chunk) {
+            return reset();
+        }
+        m_chunk = cp.m_chunk;
+        m_ptr = cp.m_ptr;
+        m_end = cp.m_chunk->data() + cp.m_chunk->m_size;
+    }
+
+    /* free everything, keeping the chunks for reuse */
+    void reset() noexcept {
+        if (m_head) {
+            _enter(m_head);
+        }
+    }
+
+    /* free everything and give the chunks back to the system */
+    void release() noexcept {
+        Chunk *chunk = m_head;
+        while (chunk) {
+            Chunk *next = chunk->m_next;
+            ::operator delete(chunk);
+            chunk = next;
+        }
+        m_head = m_chunk = nullptr;
+        m_ptr = m_end = nullptr;
+    }
+};
+
+template <class T>
+using arena_allocator = resource_allocator<T, monotonic_arena>;
+
+}
@@ -10,6 +10,7 @@ class move_only_function {
 template <class Ret, class ...Args>
 class move_only_function<Ret(Args...)> {
     struct Base {
+        virtual ~Base() = default;
         virtual void operator()(Args &&...) = 0;
     };
 
@@ -32,7 +33,7 @@ public:
             std::remove_reference_t<Fn>>, move_only_function> &&
         std::is_invocable_r_v<Ret, Fn &, Args...>, int> = 0>
     move_only_function(Fn &&fn)
-    : m_p(std::make_unique<Impl<decltype(fn)>>(std::forward<Fn>(fn)))
+    : m_p(std::make_unique<Impl<std::decay_t<Fn>>>(std::forward<Fn>(fn)))
     {}
 
     bool valid() const noexcept {
@@ -47,7 +48,8 @@ public:
 template <class Ret, class ...Args>
 class move_only_function<Ret(Args...) const> {
     struct Base {
-        virtual void operator()(Args &&...) = 0;
+        virtual ~Base() = default;
+        virtual void operator()(Args &&...) const = 0;
     };
 
     template <class Fn>
@@ -69,7 +71,7 @@ public:
             std::remove_reference_t<Fn>>, move_only_function> &&
         std::is_invocable_r_v<Ret, Fn const &, Args...>, int> = 0>
     move_only_function(Fn &&fn)
-    : m_p(std::make_unique<Impl<decltype(fn)>>(std::forward<Fn>(fn)))
+    : m_p(std::make_unique<Impl<std::decay_t<Fn>>>(std::forward<Fn>(fn)))
     {}
 
     bool valid() const noexcept {
@@ -84,7 +86,8 @@ public:
 template <class Ret, class ...Args>
 class move_only_function<Ret(Args...) noexcept> {
     struct Base {
-        virtual void operator()(Args &&...) = 0;
+        virtual ~Base() = default;
+        virtual void operator()(Args &&...) noexcept = 0;
     };
 
     template <class Fn>
@@ -106,7 +109,7 @@ public:
             std::remove_reference_t<Fn>>, move_only_function> &&
         std::is_nothrow_invocable_r_v<Ret, Fn &, Args...>, int> = 0>
     move_only_function(Fn &&fn)
-    : m_p(std::make_unique<Impl<decltype(fn)>>(std::forward<Fn>(fn)))
+    : m_p(std::make_unique<Impl<std::decay_t<Fn>>>(std::forward<Fn>(fn)))
     {}
 
     bool valid() const noexcept {
@@ -121,7 +124,8 @@ public:
 template <class Ret, class ...Args>
 class move_only_function<Ret(Args...) const noexcept> {
     struct Base {
-        virtual void operator()(Args &&...) = 0;
+        virtual ~Base() = default;
+        virtual void operator()(Args &&...) const noexcept = 0;
     };
 
     template <class Fn>
@@ -143,7 +147,7 @@ public:
             std::remove_reference_t<Fn>>, move_only_function> &&
         std::is_nothrow_invocable_r_v<Ret, Fn const &, Args...>, int> = 0>
     move_only_function(Fn &&fn)
-    : m_p(std::make_unique<Impl<decltype(fn)>>(std::forward<Fn>(fn)))
+    : m_p(std::make_unique<Impl<std::decay_t<Fn>>>(std::forward<Fn>(fn)))
     {}
 
     bool valid() const noexcept {
@@ -0,0 +1,135 @@
+#include <set>
+#include <list>
+#include <thread>
+#include <barrier>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include "pool_resource.h"
+#include "../contest/test.h"
+
+namespace constl {
+
+TEST_BEGIN()
+
+TEST(PoolResourceSizeClass) {
+    EXPECT_EQ(pool_resource::size_class(1, 1), 0);
+    EXPECT_EQ(pool_resource::size_class(8, 8), 0);
+    EXPECT_EQ(pool_resource::size_class(9, 8), 1);
+    EXPECT_EQ(pool_resource::size_class(4, 32), 2);
+    EXPECT_EQ(pool_resource::size_class(4096, 8), pool_resource::num_classes - 1);
+    EXPECT_EQ(pool_resource::is_pooled(4096, 64), true);
+    EXPECT_EQ(pool_resource::is_pooled(4097, 8), false);
+    EXPECT_EQ(pool_resource::is_pooled(64, 128), false);
+}
+
+TEST(PoolResourceReuse) {
+    pool_resource pool;
+    /* blocks of one class never overlap, and a freed block is the next one handed out */
+    std::set<std::uintptr_t> seen;
+    std::vector<void *> blocks;
+    bool ok = true;
+    for (int i = 0; i < 5000; i++) {
+        void *p = pool.allocate(24, 8);
+        ok &= reinterpret_cast<std::uintptr_t>(p) % 32 == 0;
+        ok &= seen.insert(reinterpret_cast<std::uintptr_t>(p)).second;
+        std::memset(p, i & 0xff, 24);
+        blocks.push_back(p);
+    }
+    EXPECT_EQ(ok, true);
+    pool.deallocate(blocks[1234], 24, 8);
+    EXPECT_EQ(pool.allocate(17, 8), blocks[1234]);
+
+    /* requests outside the classes go straight to operator new */
+    void *big = pool.allocate(100000, 16);
+    std::memset(big, 0, 100000);
+    pool.deallocate(big, 100000, 16);
+    void *wide = pool.allocate(64, 256);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(wide) % 256, 0);
+    pool.deallocate(wide, 64, 256);
+
+    pool.release();
+    void *p = pool.allocate(8, 8);
+    pool.deallocate(p, 8, 8);
+}
+
+TEST(PoolResourceAllocator) {
+    pool_resource pool;
+    std::list<int, pool_allocator<int>> l{pool_allocator<int>(pool)};
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 10000; i++) {
+            l.push_back(i);
+        }
+        l.clear();
+    }
+    for (int i = 0; i < 100; i++) {
+        l.push_front(i);
+    }
+    EXPECT_EQ(l.size(), 100);
+    EXPECT_EQ(l.front(), 99);
+    EXPECT_EQ(l.back(), 0);
+}
+
+/* each thread frees half of its blocks and half of another thread's, so the caches spill
+ * into the central pool and refill from it; no block is ever handed out twice at once */
+TEST(ThreadCachedPoolResourceCrossThread) {
+    constexpr int nthreads = 4, per_thread = 20000;
+    thread_cached_pool_resource pool;
+    std::vector<std::vector<int *>> owned(nthreads);
+    for (int t = 0; t < nthreads; t++) {
+        for (int i = 0; i < per_thread; i++) {
+            int *p = static_cast<int *>(pool.allocate(sizeof(int) * 4, alignof(int)));
+            p[0] = t;
+            p[1] = i;
+            owned[t].push_back(p);
+        }
+    }
+    std::vector<int> ok(nthreads, 1);
+    std::barrier sync(nthreads);
+    {
+        std::vector<std::jthread> threads;
+        for (int t = 0; t < nthreads; t++) {
+            threads.emplace_back([&, t] {
+                auto &mine = owned[t], &theirs = owned[(t + 1) % nthreads];
+                for (int i = 0; i < per_thread; i++) {
+                    ok[t] &= mine[i][0] == t && mine[i][1] == i;
+                }
+                sync.arrive_and_wait();
+                for (int i = 0; i < per_thread / 2; i++) {
+                    pool.deallocate(theirs[per_thread / 2 + i], sizeof(int) * 4, alignof(int));
+                }
+                for (int i = 0; i < per_thread / 2; i++) {
+                    int *p = static_cast<int *>(pool.allocate(sizeof(int) * 4, alignof(int)));
+                    p[0] = -1 - t;
+                    p[1] = i;
+                    theirs[per_thread / 2 + i] = p;
+                }
+            });
+        }
+    }
+    /* the replacement blocks are distinct from each other and from the kept halves */
+    std::set<int *> distinct;
+    bool kept = true;
+    for (int t = 0; t < nthreads; t++) {
+        for (int i = 0; i < per_thread; i++) {
+            distinct.insert(owned[t][i]);
+            if (i < per_thread / 2) {
+                kept &= owned[t][i][0] == t && owned[t][i][1] == i;
+            } else {
+                kept &= owned[t][i][0] == -1 - (t + nthreads - 1) % nthreads && owned[t][i][1] == i - per_thread / 2;
+            }
+        }
+    }
+    EXPECT_EQ(ok == std::vector<int>(nthreads, 1), true);
+    EXPECT_EQ(kept, true);
+    EXPECT_EQ(distinct.size(), nthreads * per_thread);
+    for (auto &v: owned) {
+        for (int *p: v) {
+            pool.deallocate(p, sizeof(int) * 4, alignof(int));
+        }
+    }
+}
+
+TEST_END()
+
+}
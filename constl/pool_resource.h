@@ -0,0 +1,231 @@
+#pragma once
+
+#include <new>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <bit>
+#include "resource_allocator.h"
+
+namespace constl {
+
+/* size-class pool: power-of-two classes from 8 to 4096 bytes, each with an
+ * intrusive free list carved out of 64 KiB slabs; bigger requests go to
+ * operator new; all slabs are returned to the system on destruction */
+struct pool_resource {
+    static constexpr std::size_t min_class_shift = 3;
+    static constexpr std::size_t max_class_shift = 12;
+    static constexpr std::size_t num_classes = max_class_shift - min_class_shift + 1;
+    static constexpr std::size_t slab_size = 64 * 1024;
+    static constexpr std::size_t slab_align = 64;
+
+    struct FreeNode {
+        FreeNode *m_next;
+    };
+
+private:
+    FreeNode *m_free[num_classes];
+    std::vector<void *> m_slabs;
+
+    void _refill(std::size_t cls) {
+        std::size_t block = std::size_t(1) << (cls + min_class_shift);
+        std::byte *slab = static_cast<std::byte *>(::operator new(slab_size, std::align_val_t(slab_align)));
+        m_slabs.push_back(slab);
+        FreeNode *head = m_free[cls];
+        for (std::size_t off = slab_size; off != 0; off -= block) {
+            FreeNode *node = reinterpret_cast<FreeNode *>(slab + off - block);
+            node->m_next = head;
+            head = node;
+        }
+        m_free[cls] = head;
+    }
+
+public:
+    static constexpr std::size_t size_class(std::size_t bytes, std::size_t align) noexcept {
+        std::size_t n = std::max({bytes, align, std::size_t(1) << min_class_shift});
+        return std::bit_width(n - 1) - min_class_shift;
+    }
+
+    static constexpr bool is_pooled(std::size_t bytes, std::size_t align) noexcept {
+        return bytes <= (std::size_t(1) << max_class_shift) && align <= slab_align;
+    }
+
+    pool_resource() noexcept : m_free{} {}
+
+    pool_resource(pool_resource &&) = delete;
+    pool_resource &operator=(pool_resource &&) = delete;
+    pool_resource(pool_resource const &) = delete;
+    pool_resource &operator=(pool_resource const &) = delete;
+
+    ~pool_resource() noexcept {
+        release();
+    }
+
+    [[nodiscard]] void *allocate(std::size_t bytes, std::size_t align = alignof(std::max_align_t)) {
+        if (!is_pooled(bytes, align)) [[unlikely]] {
+            return ::operator new(bytes, std::align_val_t(align));
+        }
+        return allocate_block(size_class(bytes, align));
+    }
+
+    void deallocate(void *p, std::size_t bytes, std::size_t align = alignof(std::max_align_t)) noexcept {
+        if (!is_pooled(bytes, align)) [[unlikely]] {
+            return ::operator delete(p, std::align_val_t(align));
+        }
+        deallocate_block(size_class(bytes, align), p);
+    }
+
+    [[nodiscard]] void *allocate_block(std::size_t cls) {
+        if (!m_free[cls]) [[unlikely]] {
+            _refill(cls);
+        }
+        FreeNode *node = m_free[cls];
+        m_free[cls] = node->m_next;
+        return node;
+    }
+
+    void deallocate_block(std::size_t cls, void *p) noexcept {
+        FreeNode *node = static_cast<FreeNode *>(p);
+        node->m_next = m_free[cls];
+        m_free[cls] = node;
+    }
+
+    /* pop up to n blocks as a linked list, returns how many were taken */
+    std::size_t take_blocks(std::size_t cls, std::size_t n, FreeNode *&head) {
+        std::size_t i = 0;
+        for (; i != n; i++) {
+            FreeNode *node = static_cast<FreeNode *>(allocate_block(cls));
+            node->m_next = head;
+            head = node;
+        }
+        return i;
+    }
+
+    void give_blocks(std::size_t cls, FreeNode *first, FreeNode *last) noexcept {
+        last->m_next = m_free[cls];
+        m_free[cls] = first;
+    }
+
+    void release() noexcept {
+        for (void *slab: m_slabs) {
+            ::operator delete(slab, std::align_val_t(slab_align));
+        }
+        m_slabs.clear();
+        std::fill(std::begin(m_free), std::end(m_free), nullptr);
+    }
+};
+
+/* pool_resource shared between threads: each thread keeps a small cache of
+ * free blocks per size class and only takes the lock to refill or spill a
+ * whole batch; blocks may be freed on a different thread than allocated */
+struct thread_cached_pool_resource {
+    static constexpr std::size_t num_classes = pool_resource::num_classes;
+    static constexpr std::size_t batch_size = 32;
+    static constexpr std::size_t cache_limit = batch_size * 2;
+
+private:
+    using FreeNode = pool_resource::FreeNode;
+
+    struct Cache {
+        FreeNode *m_free[num_classes]{};
+        std::size_t m_count[num_classes]{};
+    };
+
+    pool_resource m_central;
+    std::mutex m_mutex;
+    std::vector<std::pair<std::thread::id, std::unique_ptr<Cache>>> m_caches;
+    std::uint64_t m_serial;
+
+    static inline std::atomic<std::uint64_t> s_next_serial{1};
+
+    Cache &_local_cache() {
+        static thread_local struct {
+            std::uint64_t serial;
+            Cache *cache;
+        } tls_slots[4]{};
+        static thread_local unsigned tls_victim = 0;
+        for (auto &slot: tls_slots) {
+            if (slot.serial == m_serial) [[likely]] {
+                return *slot.cache;
+            }
+        }
+        Cache *cache = nullptr;
+        {
+            std::lock_guard lck(m_mutex);
+            auto tid = std::this_thread::get_id();
+            for (auto &[id, c]: m_caches) {
+                if (id == tid) {
+                    cache = c.get();
+                    break;
+                }
+            }
+            if (!cache) {
+                cache = m_caches.emplace_back(tid, std::make_unique<Cache>()).second.get();
+            }
+        }
+        auto &slot = tls_slots[tls_victim++ % std::size(tls_slots)];
+        slot.serial = m_serial;
+        slot.cache = cache;
+        return *cache;
+    }
+
+public:
+    thread_cached_pool_resource() noexcept
+    : m_serial(s_next_serial.fetch_add(1, std::memory_order_relaxed)) {}
+
+    thread_cached_pool_resource(thread_cached_pool_resource &&) = delete;
+    thread_cached_pool_resource &operator=(thread_cached_pool_resource &&) = delete;
+    thread_cached_pool_resource(thread_cached_pool_resource const &) = delete;
+    thread_cached_pool_resource &operator=(thread_cached_pool_resource const &) = delete;
+
+    [[nodiscard]] void *allocate(std::size_t bytes, std::size_t align = alignof(std::max_align_t)) {
+        if (!pool_resource::is_pooled(bytes, align)) [[unlikely]] {
+            return ::operator new(bytes, std::align_val_t(align));
+        }
+        std::size_t cls = pool_resource::size_class(bytes, align);
+        Cache &cache = _local_cache();
+        if (!cache.m_free[cls]) [[unlikely]] {
+            std::lock_guard lck(m_mutex);
+            cache.m_count[cls] += m_central.take_blocks(cls, batch_size, cache.m_free[cls]);
+        }
+        FreeNode *node = cache.m_free[cls];
+        cache.m_free[cls] = node->m_next;
+        --cache.m_count[cls];
+        return node;
+    }
+
+    void deallocate(void *p, std::size_t bytes, std::size_t align = alignof(std::max_align_t)) noexcept {
+        if (!pool_resource::is_pooled(bytes, align)) [[unlikely]] {
+            return ::operator delete(p, std::align_val_t(align));
+        }
+        std::size_t cls = pool_resource::size_class(bytes, align);
+        Cache &cache = _local_cache();
+        FreeNode *node = static_cast<FreeNode *>(p);
+        node->m_next = cache.m_free[cls];
+        cache.m_free[cls] = node;
+        if (++cache.m_count[cls] > cache_limit) [[unlikely]] {
+            FreeNode *first = cache.m_free[cls], *last = first;
+            for (std::size_t i = 1; i != batch_size; i++) {
+                last = last->m_next;
+            }
+            cache.m_free[cls] = last->m_next;
+            cache.m_count[cls] -= batch_size;
+            std::lock_guard lck(m_mutex);
+            m_central.give_blocks(cls, first, last);
+        }
+    }
+};
+
+template <class T>
+using pool_allocator = resource_allocator<T, pool_resource>;
+
+template <class T>
+using thread_cached_allocator = resource_allocator<T, thread_cached_pool_resource>;
+
+}
@@ -0,0 +1,118 @@
+#include <cstdint>
+#include <utility>
+#include <type_traits>
+#include "resource_allocator.h"
+#include "pool_resource.h"
+#include "flat_map.h"
+#include "../condense/SparseVec.h"
+#include "../conpool/ConcurrentQueue.h"
+#include "../contest/test.h"
+
+namespace constl {
+
+TEST_BEGIN()
+
+/* pool_resource that tracks the bytes it has outstanding, to see that a container
+ * allocates through the resource it was given and hands every byte back */
+struct CountingResource {
+    pool_resource m_pool;
+    std::size_t m_live = 0;
+    std::size_t m_nallocs = 0;
+
+    void *allocate(std::size_t bytes, std::size_t align) {
+        m_live += bytes;
+        m_nallocs++;
+        return m_pool.allocate(bytes, align);
+    }
+
+    void deallocate(void *p, std::size_t bytes, std::size_t align) noexcept {
+        m_live -= bytes;
+        m_pool.deallocate(p, bytes, align);
+    }
+};
+
+template <class T>
+using counting_allocator = resource_allocator<T, CountingResource>;
+
+using CountingMap = flat_map<int, int, generic_hash<int>, std::equal_to<int>, counting_allocator<std::pair<const int, int>>>;
+
+/* without a resource to point to, the allocator and the map have no default state */
+static_assert(!std::is_default_constructible_v<counting_allocator<int>>);
+static_assert(!std::is_default_constructible_v<CountingMap>);
+static_assert(!std::is_constructible_v<CountingMap, int const *, int const *>);
+static_assert(std::is_constructible_v<CountingMap, counting_allocator<int> const &>);
+static_assert(std::is_default_constructible_v<flat_map<int, int>>);
+
+TEST(ResourceAllocatorFlatMap) {
+    CountingResource res;
+    {
+        std::pair<const int, int> init[] = {{1, 10}, {2, 20}, {3, 30}};
+        CountingMap m(std::begin(init), std::end(init), counting_allocator<std::pair<const int, int>>(res));
+        for (int i = 4; i < 5000; i++) {
+            m.insert({i, i * 10});
+        }
+        EXPECT_GT(res.m_live, 0);
+        EXPECT_EQ(&m.get_allocator().resource() == &res, true);
+        bool ok = m.size() == 4999;
+        for (int i = 1; i < 5000; i++) {
+            ok &= m.at(i) == i * 10;
+        }
+        EXPECT_EQ(ok, true);
+        CountingMap moved(std::move(m));
+        EXPECT_EQ(moved.size(), 4999);
+        EXPECT_EQ(&moved.get_allocator().resource() == &res, true);
+    }
+    EXPECT_EQ(res.m_live, 0);
+}
+
+TEST(ResourceAllocatorSparseVec) {
+    using Vec = condense::SparseVec<int, std::uint32_t, std::size_t, counting_allocator<int>>;
+    CountingResource res;
+    {
+        Vec v{counting_allocator<int>(res)};
+        std::vector<Vec::Handle> handles;
+        for (int i = 0; i < 3000; i++) {
+            handles.push_back(v.insert(i));
+        }
+        for (int i = 0; i < 3000; i += 3) {
+            v.erase(handles[i]);
+        }
+        EXPECT_GT(res.m_live, 0);
+        Vec copy(v);
+        EXPECT_EQ(&copy.get_allocator().resource() == &res, true);
+        bool ok = copy.size() == 2000;
+        for (int i = 0; i < 3000; i++) {
+            int const *p = std::as_const(copy).at(handles[i].id);
+            ok &= i % 3 == 0 ? !p : p && *p == i;
+        }
+        EXPECT_EQ(ok, true);
+
+        /* the scratch list of erase_batch comes from the same resource */
+        std::size_t nallocs = res.m_nallocs;
+        std::uint32_t ids[] = {1, 2, 3, 4, 5};
+        EXPECT_EQ(copy.erase_batch(ids), 4);
+        EXPECT_GT(res.m_nallocs, nallocs);
+    }
+    EXPECT_EQ(res.m_live, 0);
+}
+
+TEST(ResourceAllocatorConcurrentQueue) {
+    CountingResource res;
+    {
+        conpool::ConcurrentQueue<int, counting_allocator<int>> q{counting_allocator<int>(res)};
+        for (int i = 0; i < 100; i++) {
+            q.push(i);
+        }
+        EXPECT_EQ(res.m_nallocs, 100);
+        int sum = 0;
+        while (auto v = q.try_pop()) {
+            sum += *v;
+        }
+        EXPECT_EQ(sum, 4950);
+    }
+    EXPECT_EQ(res.m_live, 0);
+}
+
+TEST_END()
+
+}
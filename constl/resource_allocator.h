@@ -0,0 +1,52 @@
+#pragma once
+
+#include <memory>
+#include <cstddef>
+#include <type_traits>
+
+namespace constl {
+
+/* stateful allocator forwarding to a memory resource that outlives it;
+ * the resource must provide allocate(bytes, align) and deallocate(p, bytes, align) */
+template <class T, class Resource>
+struct resource_allocator {
+    Resource *m_resource;
+
+    using value_type = T;
+    using resource_type = Resource;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    constexpr resource_allocator(Resource &resource) noexcept
+    : m_resource(std::addressof(resource)) {}
+
+    template <class U>
+    constexpr resource_allocator(resource_allocator<U, Resource> const &other) noexcept
+    : m_resource(other.m_resource) {}
+
+    template <class U>
+    struct rebind {
+        using other = resource_allocator<U, Resource>;
+    };
+
+    [[nodiscard]] T *allocate(std::size_t n) {
+        return static_cast<T *>(m_resource->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *p, std::size_t n) noexcept {
+        m_resource->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    Resource &resource() const noexcept {
+        return *m_resource;
+    }
+
+    template <class U>
+    constexpr bool operator==(resource_allocator<U, Resource> const &other) const noexcept {
+        return m_resource == other.m_resource;
+    }
+};
+
+}
@@ -0,0 +1,203 @@
+#include <span>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "utf8.h"
+#include "../consimd/strategy.h"
+#include "../contest/test.h"
+
+namespace constl {
+
+TEST_BEGIN()
+
+/* valid text, with every fourth piece a malformed one when bad is set: stray and surplus
+ * continuations, leads cut short by the next piece, overlongs, surrogates and bytes that
+ * never occur in UTF-8 */
+static std::u8string make_test_bytes(size_t npieces, bool bad, unsigned seed) {
+    static const char32_t samples[] = {
+        U'a', U'\n', 0x7f, 0x80, 0xe9, 0x7ff, 0x800, 0x4e2d, 0xfffd, 0xffff, 0x10000, 0x1f600, 0x10ffff,
+    };
+    static const std::u8string_view malformed[] = {
+        u8"\x80", u8"\xbf\xbf", u8"\xc3", u8"\xe2\x82", u8"\xf0\x9f\x98", u8"\xf0",
+        u8"\xc0\xaf", u8"\xe0\x80\xaf", u8"\xed\xa0\x80", u8"\xf4\x90\x80\x80",
+        u8"\xf8", u8"\xfe\xff", u8"\xe2\x82\xac\x80",
+    };
+    std::u8string s;
+    for (size_t k = 0; k < npieces; k++) {
+        seed = seed * 1103515245 + 12345;
+        unsigned r = seed >> 8;
+        if (bad && r % 4 == 0) {
+            s += malformed[r / 4 % std::size(malformed)];
+        } else {
+            char8_t buf[4];
+            char32_t cp = r % 3 ? char32_t('a' + r % 26) : samples[r / 3 % std::size(samples)];
+            s.append(buf, encode_utf8(buf, cp));
+        }
+    }
+    return s;
+}
+
+/* decodes in through utf8_stream_decoder in chunks of 0 to 40 bytes, into output buffers
+ * of 4 to 40 code points; false if it ever stops making progress */
+template <class Strategy>
+static bool stream_decode(std::u32string &out, std::u8string_view in, unsigned seed) {
+    utf8_stream_decoder<Strategy> dec;
+    std::vector<char32_t> buf(40);
+    out.clear();
+    for (size_t pos = 0; pos < in.size(); ) {
+        seed = seed * 1103515245 + 12345;
+        std::u8string_view chunk = in.substr(pos, (seed >> 8) % 41);
+        pos += chunk.size();
+        while (!chunk.empty()) {
+            seed = seed * 1103515245 + 12345;
+            std::span<char32_t> window(buf.data(), 4 + (seed >> 8) % 37);
+            auto [consumed, produced] = dec.feed(chunk, window);
+            if (!consumed && !produced) {
+                return false;
+            }
+            out.append(buf.data(), produced);
+            chunk.remove_prefix(consumed);
+        }
+    }
+    out.append(buf.data(), dec.finish(buf));
+    return dec.pending() == 0;
+}
+
+TEST_PARAMS(Utf8StreamSeeds, {
+    0, 1, 2, 3, 17, 42, 100, 1989,
+});
+
+TEST_TYPES(Utf8StreamStrategies
+           , consimd::strategy::AVX
+           , consimd::strategy::Scalar
+           );
+
+/* however the input is chunked, the stream decodes like the whole string at once, with
+ * a dangling partial sequence as one U+FFFD */
+TEST_PT(Utf8StreamDecoderChunks, Utf8StreamSeeds, Utf8StreamStrategies) {
+    const unsigned seed = getTestParam();
+    for (bool bad: {false, true}) {
+        for (size_t npieces: {0, 1, 5, 64, 700}) {
+            std::u8string in = make_test_bytes(npieces, bad, seed * 7 + (unsigned)npieces);
+            std::u32string expect;
+            if (decode_utf8_string(expect, in, TestType{})) {
+                expect.push_back(0xfffd);
+            }
+            for (unsigned split = 0; split < 8; split++) {
+                std::u32string got;
+                EXPECT_EQ(stream_decode<TestType>(got, in, seed * 131 + split), true);
+                EXPECT_EQ(got == expect, true);
+            }
+        }
+    }
+}
+
+/* malformed input decodes the same whichever pass handles it */
+TEST_T(Utf8LenientDecode, Utf8StreamStrategies) {
+    std::u32string out;
+    EXPECT_EQ(decode_utf8_string(out, u8"\xf0\x80" "A\xe2\x82\xac", TestType{}), 0);
+    EXPECT_EQ(out == U"\xfffd\xfffd" "A\x20ac", true);
+    EXPECT_EQ(decode_utf8_string(out, u8"a\xe2\x82", TestType{}), 2);
+    EXPECT_EQ(out == U"a", true);
+
+    utf8_stream_decoder<TestType> dec;
+    char32_t buf[8];
+    EXPECT_EQ(dec.feed(u8"\xf0\x9f", buf).produced, 0);
+    EXPECT_EQ(dec.pending(), 2);
+    auto r = dec.feed(u8"A", buf);
+    EXPECT_EQ(r.consumed, 1);
+    EXPECT_EQ(std::u32string(buf, r.produced) == U"\xfffd" "A", true);
+}
+
+/* decodes in whole and then one byte per feed, false if the two disagree */
+template <class Strategy>
+static bool decode_both_ways(std::u32string &out, std::u8string_view in) {
+    std::u32string whole, bytewise;
+    if (decode_utf8_string(whole, in, Strategy{})) {
+        whole.push_back(0xfffd);
+    }
+    utf8_stream_decoder<Strategy> dec;
+    char32_t buf[4];
+    for (size_t i = 0; i < in.size(); i++) {
+        auto [consumed, produced] = dec.feed(in.substr(i, 1), buf);
+        if (consumed != 1) {
+            return false;
+        }
+        bytewise.append(buf, produced);
+    }
+    bytewise.append(buf, dec.finish(buf));
+    out = whole;
+    return whole == bytewise;
+}
+
+/* overlongs, surrogates and values above U+10FFFF are ill-formed as in utf8_validate, and
+ * each maximal subpart of an ill-formed sequence becomes one U+FFFD */
+TEST_T(Utf8LenientMaximalSubpart, Utf8StreamStrategies) {
+    static const std::pair<std::u8string_view, std::u32string_view> cases[] = {
+        {u8"\xc0\x80", U"\xfffd\xfffd"},                          /* was U+0000 */
+        {u8"\xed\xa0\x80", U"\xfffd\xfffd\xfffd"},                 /* was U+D800 */
+        {u8"\xf4\x90\x80\x80", U"\xfffd\xfffd\xfffd\xfffd"},        /* was U+110000 */
+        {u8"\xe0\x80\xaf", U"\xfffd\xfffd\xfffd"},
+        {u8"\xc1\xbf" "A", U"\xfffd\xfffd" "A"},
+        {u8"\xf5\x80\x80\x80", U"\xfffd\xfffd\xfffd\xfffd"},
+        {u8"\xe2\x82" "A", U"\xfffd" "A"},
+        {u8"\xf0\x9f\x98" "A", U"\xfffd" "A"},
+        {u8"\xf0\x9f\x98\xf0\x9f\x98\x80", U"\xfffd\x1f600"},
+        {u8"\xed\x9f\xbf\xf4\x8f\xbf\xbf", U"\xd7ff\x10ffff"},
+        {u8"a\xed\xa0", U"a\xfffd\xfffd"},
+        {u8"a\xf4\x8f", U"a\xfffd"},
+    };
+    bool ok = true;
+    for (auto [in, expect]: cases) {
+        std::u32string out;
+        ok &= decode_both_ways<TestType>(out, in) && out == expect;
+    }
+    EXPECT_EQ(ok, true);
+
+    /* only a prefix that could still complete is held back */
+    std::u32string out;
+    EXPECT_EQ(decode_utf8_string(out, u8"a\xed\xa0", TestType{}), 0);
+    EXPECT_EQ(decode_utf8_string(out, u8"a\xed\x9f", TestType{}), 2);
+    EXPECT_EQ(decode_utf8_string(out, u8"a\xf4\x90", TestType{}), 0);
+    EXPECT_EQ(decode_utf8_string(out, u8"a\xf4\x8f", TestType{}), 2);
+}
+
+/* malformed input converts to the UTF-16 of its lenient decode: never a lone surrogate,
+ * and never a pair built from a value above U+10FFFF */
+TEST_T(Utf8ToUtf16Malformed, Utf8StreamStrategies) {
+    static const std::u8string_view cases[] = {
+        u8"\xed\xa0\x80\xed\xbf\xbf", u8"\xf4\x90\x80\x80", u8"\xf7\xbf\xbf\xbf",
+        u8"\xc0\x80" "a\xf0\x9f\x98\x80", u8"\xe0\x80\xaf\xef\xbf\xbd", u8"\xf4\x8f\xbf\xbf\x80",
+    };
+    bool ok = true;
+    for (std::u8string_view in: cases) {
+        std::u16string out;
+        std::u32string wide;
+        ok &= utf8_to_utf16_string(out, in, TestType{}) == 0;
+        decode_utf8_string(wide, in, TestType{});
+        std::u16string expect;
+        for (char32_t cp: wide) {
+            if (cp >= 0x10000) {
+                expect.push_back(static_cast<char16_t>(0xd800 | (cp - 0x10000) >> 10));
+                expect.push_back(static_cast<char16_t>(0xdc00 | (cp & 0x3ff)));
+            } else {
+                ok &= cp < 0xd800 || cp > 0xdfff;
+                expect.push_back(static_cast<char16_t>(cp));
+            }
+        }
+        ok &= out == expect;
+    }
+    EXPECT_EQ(ok, true);
+
+    std::u16string out;
+    utf8_to_utf16_string(out, u8"\xf4\x90\x80\x80" "A", TestType{});
+    EXPECT_EQ(out == u"\xfffd\xfffd\xfffd\xfffd" "A", true);
+    utf8_to_utf16_string(out, u8"\xed\xa0\x80", TestType{});
+    EXPECT_EQ(out == u"\xfffd\xfffd\xfffd", true);
+    utf8_to_utf16_string(out, u8"\xf4\x8f\xbf\xbf\xff", TestType{});
+    EXPECT_EQ(out == u"\xdbff\xdfff\xfffd", true);
+}
+
+TEST_END()
+
+}
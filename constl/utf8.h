@@ -2,10 +2,13 @@
 
 #include <string>
 #include <string_view>
+#include <span>
 #include <numeric>
 #include <iostream>
 #include <tuple>
 #include <algorithm>
+#include "../consimd/utf8.h"
+#include "../consimd/strategy.h"
 
 namespace constl {
 
@@ -85,44 +88,255 @@ inline char8_t *encode_utf8(char8_t *out, char32_t cp) {
     return out;
 }
 
-inline size_t decode_utf8_string(std::u32string &out, std::u8string_view in) {
-    size_t count = 0, rest = 0;
-    for (size_t i = 0; i < in.size(); ) {
-        size_t n = decode_utf8_len(in[i]);
-        if (n <= in.size() - i) {
-            i += n;
-            ++count;
-        } else {
-            rest = in.size() - i;
-            break;
+/* length of the sequence a byte starts, 0 for bytes that never start one: continuations,
+ * the overlong leads C0 and C1, and F5 to FF which would encode past U+10FFFF */
+inline size_t _utf8_lead_len(char8_t c) {
+    if (c < 0x80) {
+        return 1;
+    } else if (c >= 0xc2 && c <= 0xdf) {
+        return 2;
+    } else if (c >= 0xe0 && c <= 0xef) {
+        return 3;
+    } else if (c >= 0xf0 && c <= 0xf4) {
+        return 4;
+    } else {
+        return 0;
+    }
+}
+
+/* whether c may follow in[0, k) in a well-formed sequence; the byte after E0, ED, F0 and
+ * F4 is narrowed to rule out overlongs, surrogates and values above U+10FFFF */
+inline bool _utf8_continues(char8_t const *in, size_t k, char8_t c) {
+    if (k == 1) {
+        switch (in[0]) {
+        case 0xe0: return c >= 0xa0 && c <= 0xbf;
+        case 0xed: return c >= 0x80 && c <= 0x9f;
+        case 0xf0: return c >= 0x90 && c <= 0xbf;
+        case 0xf4: return c >= 0x80 && c <= 0x8f;
+        }
+    }
+    return (c & 0b1100'0000) == 0b1000'0000;
+}
+
+/* length and value of the sequence at the start of in[0, size), with the same notion of
+ * well-formed as utf8_validate; an ill-formed one decodes to a single U+FFFD spanning its
+ * maximal subpart, i.e. an invalid lead byte alone, or a valid lead with the bytes that
+ * could still continue it. length 0 if a valid prefix runs past the end, so the result
+ * never depends on where the input was split */
+inline std::pair<size_t, char32_t> _decode_utf8_lenient(char8_t const *in, size_t size) {
+    size_t n = _utf8_lead_len(in[0]);
+    if (!n) {
+        return {1, 0xfffd};
+    }
+    for (size_t k = 1; k < n; k++) {
+        if (k == size) {
+            return {0, 0xfffd};
+        }
+        if (!_utf8_continues(in, k, in[k])) {
+            return {k, 0xfffd};
         }
     }
+    return {n, decode_utf8(in).second};
+}
+
+/* in must not end with a valid prefix that a later byte could complete (see
+ * _utf8_incomplete_tail); a cut-short prefix decodes to U+FFFD like any other */
+inline void _decode_utf8_string_lenient(std::u32string &out, std::u8string_view in) {
+    size_t count = 0;
+    for (size_t i = 0; i < in.size(); ++count) {
+        size_t n = _decode_utf8_lenient(in.data() + i, in.size() - i).first;
+        i += n ? n : in.size() - i;
+    }
     out.resize(count);
-    char32_t *out_p = out.data();
-    char8_t const *in_p = in.data();
-    for (size_t i = 0; i < count; i++) {
-        char32_t cp;
-        std::tie(in_p, cp) = decode_utf8(in_p);
-        *out_p++ = cp;
+    for (size_t j = 0, i = 0; j < count; j++) {
+        auto [n, cp] = _decode_utf8_lenient(in.data() + i, in.size() - i);
+        out[j] = cp;
+        i += n ? n : in.size() - i;
+    }
+}
+
+/* length of a valid prefix cut off by the end of in, 0 if the last sequence is complete
+ * or already known to be ill-formed */
+inline size_t _utf8_incomplete_tail(std::u8string_view in) {
+    size_t k = 0;
+    while (k < 3 && k < in.size() && (in[in.size() - 1 - k] & 0b1100'0000) == 0b1000'0000) {
+        ++k;
+    }
+    if (k == in.size()) {
+        return 0;
     }
+    return _decode_utf8_lenient(in.data() + in.size() - 1 - k, k + 1).first ? 0 : k + 1;
+}
+
+template <class Strategy = consimd::strategy::Scalar>
+inline bool validate_utf8(std::u8string_view in, Strategy = {}) {
+    return consimd::utf8_validate<Strategy>()(in.data(), in.size()) != consimd::utf8_invalid;
+}
+
+/* returns the number of trailing bytes left undecoded because the input ends mid-sequence;
+ * well-formed input is counted while validating and decoded in one more pass, malformed
+ * sequences decode to U+FFFD */
+template <class Strategy = consimd::strategy::Scalar>
+inline size_t decode_utf8_string(std::u32string &out, std::u8string_view in, Strategy = {}) {
+    size_t rest = _utf8_incomplete_tail(in);
+    in.remove_suffix(rest);
+    size_t count = consimd::utf8_validate<Strategy>()(in.data(), in.size());
+    if (count == consimd::utf8_invalid) [[unlikely]] {
+        _decode_utf8_string_lenient(out, in);
+        return rest;
+    }
+    out.resize(count);
+    consimd::utf8_decode<Strategy>()(in.data(), out.data(), in.size());
     return rest;
 }
 
-inline void encode_utf8_string(std::u8string &out, std::u32string_view in) {
-    size_t len = std::transform_reduce(in.begin(), in.end(),
-                                       static_cast<size_t>(0), std::plus<size_t>(),
-                                       encode_utf8_len);
-    out.resize(len);
-    std::accumulate(in.begin(), in.end(), out.data(), encode_utf8);
+template <class Strategy = consimd::strategy::Scalar>
+inline void encode_utf8_string(std::u8string &out, std::u32string_view in, Strategy = {}) {
+    out.resize(consimd::utf8_encode_length<Strategy>()(in.data(), in.size()));
+    consimd::utf8_encode<Strategy>()(in.data(), out.data(), in.size());
 }
 
+/* same contract as decode_utf8_string, but producing UTF-16 */
+template <class Strategy = consimd::strategy::Scalar>
+inline size_t utf8_to_utf16_string(std::u16string &out, std::u8string_view in, Strategy = {}) {
+    size_t rest = _utf8_incomplete_tail(in);
+    in.remove_suffix(rest);
+    if (consimd::utf8_validate<Strategy>()(in.data(), in.size()) == consimd::utf8_invalid) [[unlikely]] {
+        std::u32string tmp;
+        _decode_utf8_string_lenient(tmp, in);
+        out.clear();
+        for (char32_t cp: tmp) {
+            if (cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) [[unlikely]] {
+                cp = 0xfffd;
+            }
+            if (cp >= 0x10000) {
+                cp -= 0x10000;
+                out.push_back(static_cast<char16_t>(0xd800 | cp >> 10));
+                out.push_back(static_cast<char16_t>(0xdc00 | (cp & 0x3ff)));
+            } else {
+                out.push_back(static_cast<char16_t>(cp));
+            }
+        }
+        return rest;
+    }
+    out.resize(consimd::utf8_to_utf16_length<Strategy>()(in.data(), in.size()));
+    consimd::utf8_to_utf16<Strategy>()(in.data(), out.data(), in.size());
+    return rest;
+}
+
+/* returns 1 if in ends with a high surrogate, which is left unconverted for the next
+ * call; other unpaired surrogates become U+FFFD */
+template <class Strategy = consimd::strategy::Scalar>
+inline size_t utf16_to_utf8_string(std::u8string &out, std::u16string_view in, Strategy = {}) {
+    size_t rest = !in.empty() && (in.back() & 0xfc00) == 0xd800;
+    in.remove_suffix(rest);
+    out.resize(consimd::utf16_to_utf8_length<Strategy>()(in.data(), in.size()));
+    consimd::utf16_to_utf8<Strategy>()(in.data(), out.data(), in.size());
+    return rest;
+}
+
+struct utf8_stream_result {
+    size_t consumed;
+    size_t produced;
+};
+
+/* decodes UTF-8 arriving in arbitrary chunks into caller-provided buffers; a sequence
+ * split across two feeds is kept in the decoder (at most 3 bytes), so chunks never need
+ * to be concatenated. malformed bytes decode to U+FFFD as in decode_utf8_string */
+template <class Strategy = consimd::strategy::Scalar>
+struct utf8_stream_decoder {
+private:
+    char8_t m_pending[4]{};
+    size_t m_npending = 0;
+
+    static size_t _decode_complete(char8_t const *in, size_t size, char32_t *out) {
+        size_t count = consimd::utf8_validate<Strategy>()(in, size);
+        if (count != consimd::utf8_invalid) [[likely]] {
+            consimd::utf8_decode<Strategy>()(in, out, size);
+            return count;
+        }
+        char32_t *out_p = out;
+        for (size_t i = 0; i < size; ) {
+            auto [n, cp] = _decode_utf8_lenient(in + i, size - i);
+            *out_p++ = cp;
+            i += n ? n : size - i;
+        }
+        return out_p - out;
+    }
+
+public:
+    /* consumes as much of in as fits into out; out should have room for at least 4 code
+     * points, smaller buffers may not make progress on a multi-byte sequence */
+    utf8_stream_result feed(std::u8string_view in, std::span<char32_t> out) {
+        size_t consumed = 0, produced = 0;
+        if (m_npending) {
+            /* extend the pending prefix byte by byte until it completes or breaks */
+            size_t k = 0, n = 0;
+            while (!n && k < in.size()) {
+                m_pending[m_npending + k] = in[k];
+                n = _decode_utf8_lenient(m_pending, m_npending + ++k).first;
+            }
+            if (!n) {
+                m_npending += k;
+                return {k, 0};
+            }
+            if (out.empty()) {
+                return {0, 0};
+            }
+            /* cut short by a byte that cannot continue it, the pending bytes become one
+             * U+FFFD just as if the chunks had come in one piece, and that byte is left
+             * for the main pass */
+            out[0] = _decode_utf8_lenient(m_pending, n).second;
+            produced = 1;
+            consumed = n - m_npending;
+            m_npending = 0;
+        }
+        std::u8string_view window = in.substr(consumed, out.size() - produced);
+        size_t tail = _utf8_incomplete_tail(window);
+        window.remove_suffix(tail);
+        produced += _decode_complete(window.data(), window.size(), out.data() + produced);
+        consumed += window.size();
+        if (consumed + tail == in.size()) {
+            /* only a sequence cut by the end of this chunk is carried over */
+            std::copy_n(in.data() + consumed, tail, m_pending);
+            m_npending = tail;
+            consumed += tail;
+        }
+        return {consumed, produced};
+    }
+
+    /* call at end of input: a dangling partial sequence becomes U+FFFD, returns the
+     * number of code points written (0 or 1) */
+    size_t finish(std::span<char32_t> out) {
+        if (!m_npending || out.empty()) {
+            return 0;
+        }
+        out[0] = 0xfffd;
+        m_npending = 0;
+        return 1;
+    }
+
+    size_t pending() const noexcept {
+        return m_npending;
+    }
+
+    void reset() noexcept {
+        m_npending = 0;
+    }
+};
+
 }
 
 using _utf8_details::decode_utf8;
 using _utf8_details::encode_utf8;
 using _utf8_details::decode_utf8_len;
 using _utf8_details::encode_utf8_len;
+using _utf8_details::validate_utf8;
 using _utf8_details::decode_utf8_string;
 using _utf8_details::encode_utf8_string;
+using _utf8_details::utf8_to_utf16_string;
+using _utf8_details::utf16_to_utf8_string;
+using _utf8_details::utf8_stream_result;
+using _utf8_details::utf8_stream_decoder;
 
 }